@@ -0,0 +1,182 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "SensorPacket.h"
+
+/// @brief データ転送
+namespace DeviceData
+{
+    /// @brief DeviceDataの構造体に対応するDeviceID
+    /// @details 構造体のないDeviceID(MainBoard)は対応しない
+    template <typename T>
+    struct DeviceIDOf;
+
+    template <> struct DeviceIDOf<ServoData> { enum { value = ServoController }; };
+    template <> struct DeviceIDOf<TachometerData> { enum { value = Tachometer }; };
+    template <> struct DeviceIDOf<PitotData> { enum { value = Pitot }; };
+    template <> struct DeviceIDOf<IMUData> { enum { value = IMU }; };
+    template <> struct DeviceIDOf<UltraSonicData> { enum { value = UltraSonic }; };
+    template <> struct DeviceIDOf<GPSData> { enum { value = GPS }; };
+    template <> struct DeviceIDOf<VaneData> { enum { value = Vane }; };
+    template <> struct DeviceIDOf<BarometerData> { enum { value = Barometer }; };
+
+    /// @brief 受信したDeviceDataを型ごとのハンドラに振り分ける
+    /// @details 先頭のidの上位4bitで種類を引き、サイズがsizeof(T)と一致すれば
+    /// アラインされたTにコピーしてhandler(const T&)を呼ぶ。
+    /// 振り分け先は上位4bitで引くコンパイル時の関数表で、仮想呼び出しはない。
+    ///
+    ///     struct Logger
+    ///     {
+    ///         void operator()(const DeviceData::IMUData &data);
+    ///         void operator()(const DeviceData::GPSData &data);
+    ///     };
+    ///
+    ///     DeviceData::Router<Logger, DeviceData::IMUData, DeviceData::GPSData> router;
+    ///
+    ///     // 無線の受信
+    ///     router(packet.get_payload().begin(), packet.get_payload().size());
+    ///
+    ///     // PacketSerial_のHandlerTypeとしても使える
+    ///     PacketSerial_<COBS, 0, 256, false, NoFrameCheck,
+    ///                   PacketSerialOptions<DeviceData::Router<Logger, DeviceData::IMUData>>> link;
+    ///
+    /// @tparam Handler 各Tについてoperator()(const T&)を持つ型
+    /// @tparam Types 振り分けるDeviceDataの構造体。上位4bitが同じものを
+    /// 2つ並べると片方が黙って使われなくなるので、コンパイルエラーにする
+    template <typename Handler, typename... Types>
+    class Router
+    {
+    public:
+        /// @brief 振り分け関数の型
+        typedef bool (*Route)(Handler &handler, const uint8_t *buffer, size_t size);
+
+        Router() : _unknownCount(0), _sizeErrorCount(0)
+        {
+        }
+
+        explicit Router(const Handler &handler) : _handler(handler), _unknownCount(0), _sizeErrorCount(0)
+        {
+        }
+
+        /// @brief 1フレームを振り分ける
+        /// @return ハンドラを呼んだらtrue
+        bool operator()(const uint8_t *buffer, size_t size)
+        {
+            if (size == 0)
+            {
+                return false;
+            }
+
+            Route route = table[buffer[0] >> 4];
+
+            if (route == nullptr)
+            {
+                _unknownCount++;
+                return false;
+            }
+
+            if (!route(_handler, buffer, size))
+            {
+                _sizeErrorCount++;
+                return false;
+            }
+
+            return true;
+        }
+
+        /// @brief ハンドラ
+        Handler &handler()
+        {
+            return _handler;
+        }
+
+        /// @brief 振り分け先のないidのフレーム数
+        size_t unknownCount() const
+        {
+            return _unknownCount;
+        }
+
+        /// @brief サイズがsizeof(T)と一致しなかったフレーム数
+        size_t sizeErrorCount() const
+        {
+            return _sizeErrorCount;
+        }
+
+        /// @brief 上位4bitで引く関数表
+        static const Route table[16];
+
+    private:
+        template <typename T>
+        static bool route(Handler &handler, const uint8_t *buffer, size_t size)
+        {
+            if (size != sizeof(T))
+            {
+                return false;
+            }
+
+            T data;
+            memcpy(&data, buffer, sizeof(T));
+            handler(static_cast<const T &>(data));
+            return true;
+        }
+
+        /// @brief 上位4bitがTypeのTを探す
+        template <int Type, typename... Rest>
+        struct Find
+        {
+            static constexpr Route get()
+            {
+                return nullptr;
+            }
+        };
+
+        template <int Type, typename T, typename... Rest>
+        struct Find<Type, T, Rest...>
+        {
+            static constexpr Route get()
+            {
+                return (DeviceIDOf<T>::value >> 4) == Type ? &Router::template route<T> : Find<Type, Rest...>::get();
+            }
+        };
+
+        /// @brief 上位4bitがTypeのTの数
+        template <int Type, typename... Rest>
+        struct Count
+        {
+            enum { value = 0 };
+        };
+
+        template <int Type, typename T, typename... Rest>
+        struct Count<Type, T, Rest...>
+        {
+            enum { value = ((DeviceIDOf<T>::value >> 4) == Type ? 1 : 0) + Count<Type, Rest...>::value };
+        };
+
+        /// @brief 上位4bitが重複するTがなければ1
+        template <typename... Rest>
+        struct Distinct
+        {
+            enum { value = 1 };
+        };
+
+        template <typename T, typename... Rest>
+        struct Distinct<T, Rest...>
+        {
+            enum { value = Count<(DeviceIDOf<T>::value >> 4), Rest...>::value == 0 && Distinct<Rest...>::value };
+        };
+
+        static_assert(Distinct<Types...>::value, "Router: 上位4bitが同じDeviceDataが2つある");
+
+        Handler _handler;
+        size_t _unknownCount;
+        size_t _sizeErrorCount;
+    };
+
+    template <typename Handler, typename... Types>
+    const typename Router<Handler, Types...>::Route Router<Handler, Types...>::table[16] = {
+        Find<0x0, Types...>::get(), Find<0x1, Types...>::get(), Find<0x2, Types...>::get(), Find<0x3, Types...>::get(),
+        Find<0x4, Types...>::get(), Find<0x5, Types...>::get(), Find<0x6, Types...>::get(), Find<0x7, Types...>::get(),
+        Find<0x8, Types...>::get(), Find<0x9, Types...>::get(), Find<0xA, Types...>::get(), Find<0xB, Types...>::get(),
+        Find<0xC, Types...>::get(), Find<0xD, Types...>::get(), Find<0xE, Types...>::get(), Find<0xF, Types...>::get()};
+}
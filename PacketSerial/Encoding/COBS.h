@@ -8,6 +8,12 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "PacketFragment.h"
+#include "FrameCheck.h"
+
 /// \brief A Consistent Overhead Byte Stuffing (COBS) Encoder.
 ///
 /// Consistent Overhead Byte Stuffing (COBS) is an encoding that removes all 0
@@ -70,6 +76,118 @@ public:
         return write_index;
     }
 
+    /// \brief Encode a packet scattered over several buffers.
+    ///
+    /// Produces the same output as encode() on the concatenated fragments.
+    ///
+    /// \param fragments A pointer to the array of fragments to encode.
+    /// \param count The number of fragments in the array.
+    /// \param encodedBuffer The buffer for the encoded bytes.
+    /// \returns The number of bytes written to the \p encodedBuffer.
+    /// \warning The encodedBuffer must have at least getEncodedBufferSize()
+    ///          of the total fragment size allocated.
+    static size_t encode(const PacketFragment* fragments,
+                         size_t count,
+                         uint8_t* encodedBuffer)
+    {
+        size_t write_index = 1;
+        size_t code_index  = 0;
+        uint8_t code       = 1;
+
+        for (size_t fragment = 0; fragment < count; fragment++)
+        {
+            const uint8_t* buffer = fragments[fragment].buffer;
+            size_t size = fragments[fragment].size;
+
+            for (size_t read_index = 0; read_index < size; read_index++)
+            {
+                if (buffer[read_index] == 0)
+                {
+                    encodedBuffer[code_index] = code;
+                    code = 1;
+                    code_index = write_index++;
+                }
+                else
+                {
+                    encodedBuffer[write_index++] = buffer[read_index];
+                    code++;
+
+                    if (code == 0xFF)
+                    {
+                        encodedBuffer[code_index] = code;
+                        code = 1;
+                        code_index = write_index++;
+                    }
+                }
+            }
+        }
+
+        encodedBuffer[code_index] = code;
+
+        return write_index;
+    }
+
+    /// \brief Encode a byte buffer, scanning for zero bytes a word at a time.
+    ///
+    /// Produces exactly the same output as encode(), but tests 4 or 8 bytes
+    /// (the width of `unsigned long`) per step for a zero byte and copies each
+    /// zero-free run into the \p encodedBuffer in bulk. Best suited to
+    /// payloads with long zero-free runs.
+    ///
+    /// \param buffer A pointer to the unencoded buffer to encode.
+    /// \param size  The number of bytes in the \p buffer.
+    /// \param encodedBuffer The buffer for the encoded bytes.
+    /// \returns The number of bytes written to the \p encodedBuffer.
+    /// \warning The encodedBuffer must have at least getEncodedBufferSize() 
+    ///          allocated.
+    static size_t encodeWordwise(const uint8_t* buffer,
+                                 size_t size,
+                                 uint8_t* encodedBuffer)
+    {
+        size_t read_index  = 0;
+        size_t write_index = 1;
+        size_t code_index  = 0;
+        uint8_t code       = 1;
+
+        while (read_index < size)
+        {
+            size_t limit = size - read_index;
+
+            if (limit > 0xFE)
+                limit = 0xFE;
+
+            size_t run = zeroFreeRunLength(buffer + read_index, limit);
+
+            memcpy(encodedBuffer + write_index, buffer + read_index, run);
+            write_index += run;
+            read_index += run;
+
+            if (run == 0xFE)
+            {
+                encodedBuffer[code_index] = 0xFF;
+                code = 1;
+                code_index = write_index++;
+            }
+            else
+            {
+                code = (uint8_t)(run + 1);
+
+                if (read_index < size)
+                {
+                    // The run was ended by a zero byte.
+                    encodedBuffer[code_index] = code;
+                    code = 1;
+                    code_index = write_index++;
+                    read_index++;
+                }
+            }
+        }
+
+        encodedBuffer[code_index] = code;
+
+        return write_index;
+    }
+
 
     /// \brief Decode a COBS-encoded buffer.
     /// \param encodedBuffer A pointer to the \p encodedBuffer to decode.
@@ -114,12 +232,343 @@ public:
         return write_index;
     }
 
+    /// \brief Decode a COBS-encoded buffer in place.
+    ///
+    /// The decoded output is never longer than the input and decode() never
+    /// writes ahead of the byte it is reading, so the \p buffer can be used as
+    /// both source and destination.
+    ///
+    /// \param buffer A pointer to the encoded buffer, overwritten with the
+    ///        decoded bytes.
+    /// \param size The number of bytes in the \p buffer.
+    /// \returns The number of decoded bytes at the start of the \p buffer.
+    static size_t decodeInPlace(uint8_t* buffer, size_t size)
+    {
+        return decode(buffer, size, buffer);
+    }
+
     /// \brief Get the maximum encoded buffer size for an unencoded buffer size.
     /// \param unencodedBufferSize The size of the buffer to be encoded.
     /// \returns the maximum size of the required encoded buffer.
-    static size_t getEncodedBufferSize(size_t unencodedBufferSize)
+    static constexpr size_t getEncodedBufferSize(size_t unencodedBufferSize)
     {
         return unencodedBufferSize + unencodedBufferSize / 254 + 1;
     }
 
+    /// \brief A COBS encoder that writes straight to a stream.
+    ///
+    /// Each block is measured in the source first, so its code byte can be
+    /// written before its data. No encode buffer is needed and the first byte
+    /// reaches the stream before the rest of the payload has been encoded.
+    /// The bytes written are the same as those produced by encode().
+    ///
+    /// The stream may be any object with a `write(uint8_t)` method, e.g.
+    /// `Serial`.
+    class StreamEncoder
+    {
+    public:
+        /// \brief Encode a byte buffer to a stream.
+        /// \param buffer A pointer to the unencoded buffer to encode.
+        /// \param size  The number of bytes in the \p buffer.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType>
+        static size_t encode(const uint8_t* buffer,
+                             size_t size,
+                             StreamType& stream)
+        {
+            NoFrameCheck frameCheck;
+            return encode(buffer, size, stream, frameCheck);
+        }
+
+        /// \brief Encode a packet scattered over several buffers to a stream.
+        /// \param fragments A pointer to the array of fragments to encode.
+        /// \param count The number of fragments in the array.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType>
+        static size_t encode(const PacketFragment* fragments,
+                             size_t count,
+                             StreamType& stream)
+        {
+            NoFrameCheck frameCheck;
+            return encode(fragments, count, stream, frameCheck);
+        }
+
+        /// \brief Encode a byte buffer and its check value to a stream.
+        /// \param buffer A pointer to the unencoded buffer to encode.
+        /// \param size  The number of bytes in the \p buffer.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \param frameCheck The frame check to compute and append, e.g.
+        ///        CRC16FrameCheck. It must be reset.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType, typename FrameCheckType>
+        static size_t encode(const uint8_t* buffer,
+                             size_t size,
+                             StreamType& stream,
+                             FrameCheckType& frameCheck)
+        {
+            PacketFragment fragment = { buffer, size };
+            return encode(&fragment, 1, stream, frameCheck);
+        }
+
+        /// \brief Encode a scattered packet and its check value to a stream.
+        ///
+        /// The check value is computed while each block is measured, in the
+        /// same pass over the payload, and is encoded as if it were one more
+        /// fragment after the last.
+        ///
+        /// \param fragments A pointer to the array of fragments to encode.
+        /// \param count The number of fragments in the array.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \param frameCheck The frame check to compute and append, e.g.
+        ///        CRC16FrameCheck. It must be reset.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType, typename FrameCheckType>
+        static size_t encode(const PacketFragment* fragments,
+                             size_t count,
+                             StreamType& stream,
+                             FrameCheckType& frameCheck)
+        {
+            // Fragment index `count` is the check value.
+            uint8_t check[FrameCheckType::Size + 1] = { 0 };
+            bool checkReady = false;
+
+            size_t fragment = 0;
+            size_t offset   = 0;
+            size_t written  = 0;
+
+            for (;;)
+            {
+                // Measure the next zero-free block so its code byte can go first.
+                size_t run  = 0;
+                size_t next = fragment;
+                size_t end  = offset;
+
+                while (next <= count && run < 0xFE)
+                {
+                    if (next == count && !checkReady)
+                    {
+                        // The whole payload has been measured, and so checked.
+                        frameCheck.get(check);
+                        checkReady = true;
+                    }
+
+                    const uint8_t* data = (next < count) ? fragments[next].buffer : check;
+                    size_t size = (next < count) ? fragments[next].size : (size_t)FrameCheckType::Size;
+                    size_t limit = size - end;
+
+                    if (limit > 0xFE - run)
+                        limit = 0xFE - run;
+
+                    size_t found = zeroFreeRunLength(data + end, limit);
+
+                    if (next < count)
+                        frameCheck.update(data + end, found < limit ? found + 1 : found);
+
+                    run += found;
+                    end += found;
+
+                    if (found < limit)
+                        break;
+
+                    if (end == size)
+                    {
+                        next++;
+                        end = 0;
+                    }
+                }
+
+                stream.write((uint8_t)(run == 0xFE ? 0xFF : run + 1));
+
+                for (size_t i = 0; i < run; i++)
+                {
+                    while (offset == fragmentSize(fragments, count, fragment, FrameCheckType::Size))
+                    {
+                        fragment++;
+                        offset = 0;
+                    }
+
+                    stream.write((fragment < count) ? fragments[fragment].buffer[offset++] : check[offset++]);
+                }
+
+                written += run + 1;
+
+                if (run == 0xFE)
+                    continue;
+
+                while (fragment <= count && offset == fragmentSize(fragments, count, fragment, FrameCheckType::Size))
+                {
+                    fragment++;
+                    offset = 0;
+                }
+
+                if (fragment > count)
+                    break;
+
+                // Skip the zero byte that ended the block.
+                offset++;
+            }
+
+            return written;
+        }
+
+    private:
+        static size_t fragmentSize(const PacketFragment* fragments,
+                                   size_t count,
+                                   size_t fragment,
+                                   size_t checkSize)
+        {
+            return (fragment < count) ? fragments[fragment].size : checkSize;
+        }
+    };
+
+    /// \brief A byte-at-a-time COBS decoder.
+    ///
+    /// Decodes an encoded frame as its bytes arrive, so the raw frame never
+    /// needs to be stored and no second pass is required when the packet
+    /// marker is seen. Pushing every byte of a frame and then calling
+    /// finish() yields the same bytes as decode().
+    ///
+    ///     COBS::StreamDecoder decoder;
+    ///
+    ///     if (!decoder.push(data, decodedBuffer, decodedSize, capacity))
+    ///     {
+    ///         // The decoded frame no longer fits in decodedBuffer.
+    ///     }
+    ///
+    class StreamDecoder
+    {
+    public:
+        /// \brief Construct a decoder waiting for the first code byte.
+        StreamDecoder():
+            _code(0xFF),
+            _remaining(0)
+        {
+        }
+
+        /// \brief Discard any partially decoded frame.
+        void reset()
+        {
+            _code = 0xFF;
+            _remaining = 0;
+        }
+
+        /// \brief Decode the next encoded byte of the frame.
+        /// \param data The next encoded byte.
+        /// \param decodedBuffer The buffer receiving the decoded frame.
+        /// \param decodedSize The number of bytes already in the
+        ///        \p decodedBuffer, advanced by the bytes this call decodes.
+        /// \param capacity The capacity of the \p decodedBuffer.
+        /// \returns false if a decoded byte did not fit in the \p decodedBuffer.
+        bool push(uint8_t data,
+                  uint8_t* decodedBuffer,
+                  size_t& decodedSize,
+                  size_t capacity)
+        {
+            if (_remaining > 0)
+            {
+                _remaining--;
+                return append(data, decodedBuffer, decodedSize, capacity);
+            }
+
+            // A new code byte. The zero implied by the previous block is only
+            // emitted now that we know the frame did not end there.
+            bool pendingZero = (_code != 0xFF);
+
+            _code = data;
+            _remaining = (data > 1) ? data - 1 : 0;
+
+            if (pendingZero)
+            {
+                return append(0, decodedBuffer, decodedSize, capacity);
+            }
+
+            return true;
+        }
+
+        /// \brief Complete the frame and prepare for the next one.
+        /// \returns false if the frame ended part way through a block, in
+        ///          which case decode() would have returned 0.
+        bool finish()
+        {
+            bool valid = (_remaining == 0);
+            reset();
+            return valid;
+        }
+
+    private:
+        static bool append(uint8_t data,
+                           uint8_t* decodedBuffer,
+                           size_t& decodedSize,
+                           size_t capacity)
+        {
+            if (decodedSize >= capacity)
+                return false;
+
+            decodedBuffer[decodedSize++] = data;
+            return true;
+        }
+
+        uint8_t _code;
+        uint8_t _remaining;
+    };
+
+private:
+    /// \brief Count the leading non-zero bytes of a buffer.
+    ///
+    /// Words are loaded with memcpy() so unaligned buffers are safe on cores
+    /// without unaligned access. The zero test is byte-order independent.
+    ///
+    /// \param buffer A pointer to the bytes to scan.
+    /// \param size The maximum number of bytes to scan.
+    /// \returns The index of the first zero byte, or \p size if there is none.
+    static size_t zeroFreeRunLength(const uint8_t* buffer, size_t size)
+    {
+        typedef unsigned long Word;
+
+        const Word ones  = ~(Word)0 / 0xFF;
+        const Word highs = ones * 0x80;
+
+        size_t index = 0;
+
+        while (index + sizeof(Word) <= size)
+        {
+            Word word;
+            memcpy(&word, buffer + index, sizeof(Word));
+
+            if ((word - ones) & ~word & highs)
+                break;
+
+            index += sizeof(Word);
+        }
+
+        while (index < size && buffer[index] != 0)
+            index++;
+
+        return index;
+    }
+
+};
+
+/// \brief A COBS encoder whose buffer encode() is COBS::encodeWordwise().
+///
+/// For code that encodes into a buffer itself, such as a gateway
+/// re-encoding frames. It is not a faster `EncoderType` for `PacketSerial_`:
+/// PacketSerial_ sends through the inherited COBS::StreamEncoder, which
+/// already measures each block with the same word-at-a-time zero scan, so
+/// `PacketSerial_<WordwiseCOBS>` behaves exactly like `PacketSerial_<COBS>`.
+/// The fragment overload of encode() and decoding are COBS's own.
+class WordwiseCOBS: public COBS
+{
+public:
+    using COBS::encode;
+
+    /// \brief Encode a byte buffer with COBS::encodeWordwise().
+    static size_t encode(const uint8_t* buffer,
+                         size_t size,
+                         uint8_t* encodedBuffer)
+    {
+        return encodeWordwise(buffer, size, encodedBuffer);
+    }
 };
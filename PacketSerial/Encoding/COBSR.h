@@ -0,0 +1,154 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// \brief A Consistent Overhead Byte Stuffing, Reduced (COBS/R) Encoder.
+///
+/// COBS/R is a small modification of COBS that often avoids the one byte of
+/// overhead. If the last byte of the data is greater than or equal to what
+/// would be the final code byte, that data byte replaces the final code byte
+/// and is dropped from the end of the frame. The decoder detects this because
+/// the final code byte then points past the end of the frame.
+///
+/// For short payloads that end in a non-zero byte, such as most `DeviceData`
+/// structs, this saves one byte per frame. The worst case is the same as COBS.
+///
+/// \sa https://pythonhosted.org/cobs/cobsr-intro.html
+class COBSR
+{
+public:
+    /// \brief Encode a byte buffer with the COBS/R encoder.
+    /// \param buffer A pointer to the unencoded buffer to encode.
+    /// \param size  The number of bytes in the \p buffer.
+    /// \param encodedBuffer The buffer for the encoded bytes.
+    /// \returns The number of bytes written to the \p encodedBuffer.
+    /// \warning The encodedBuffer must have at least getEncodedBufferSize()
+    ///          allocated.
+    static size_t encode(const uint8_t* buffer,
+                         size_t size,
+                         uint8_t* encodedBuffer)
+    {
+        size_t read_index  = 0;
+        size_t write_index = 1;
+        size_t code_index  = 0;
+        uint8_t code       = 1;
+        uint8_t last       = 0;
+
+        while (read_index < size)
+        {
+            last = buffer[read_index++];
+
+            if (last == 0)
+            {
+                encodedBuffer[code_index] = code;
+                code = 1;
+                code_index = write_index++;
+            }
+            else
+            {
+                encodedBuffer[write_index++] = last;
+                code++;
+
+                if (code == 0xFF && read_index < size)
+                {
+                    encodedBuffer[code_index] = code;
+                    code = 1;
+                    code_index = write_index++;
+                }
+            }
+        }
+
+        if (last >= code)
+        {
+            // The final data byte becomes the final code byte.
+            encodedBuffer[code_index] = last;
+            write_index--;
+        }
+        else
+        {
+            encodedBuffer[code_index] = code;
+        }
+
+        return write_index;
+    }
+
+    /// \brief Decode a COBS/R-encoded buffer.
+    /// \param encodedBuffer A pointer to the \p encodedBuffer to decode.
+    /// \param size The number of bytes in the \p encodedBuffer.
+    /// \param decodedBuffer The target buffer for the decoded bytes.
+    /// \returns The number of bytes written to the \p decodedBuffer, or 0 if
+    ///          the \p encodedBuffer contains a zero code byte.
+    /// \warning decodedBuffer must have a minimum capacity of size.
+    static size_t decode(const uint8_t* encodedBuffer,
+                         size_t size,
+                         uint8_t* decodedBuffer)
+    {
+        size_t read_index  = 0;
+        size_t write_index = 0;
+
+        while (read_index < size)
+        {
+            uint8_t code = encodedBuffer[read_index++];
+
+            if (code == 0)
+            {
+                return 0;
+            }
+
+            size_t length = code - 1;
+
+            if (length > size - read_index)
+            {
+                // A reduced final block: the code byte is the last data byte.
+                while (read_index < size)
+                {
+                    decodedBuffer[write_index++] = encodedBuffer[read_index++];
+                }
+
+                decodedBuffer[write_index++] = code;
+                break;
+            }
+
+            for (size_t i = 0; i < length; i++)
+            {
+                decodedBuffer[write_index++] = encodedBuffer[read_index++];
+            }
+
+            if (code != 0xFF && read_index != size)
+            {
+                decodedBuffer[write_index++] = '\0';
+            }
+        }
+
+        return write_index;
+    }
+
+    /// \brief Decode a COBS/R-encoded buffer in place.
+    ///
+    /// Like COBS::decodeInPlace(), decode() never writes ahead of the byte it
+    /// is reading, so the \p buffer can be used as source and destination.
+    ///
+    /// \param buffer A pointer to the encoded buffer, overwritten with the
+    ///        decoded bytes.
+    /// \param size The number of bytes in the \p buffer.
+    /// \returns The number of decoded bytes at the start of the \p buffer.
+    static size_t decodeInPlace(uint8_t* buffer, size_t size)
+    {
+        return decode(buffer, size, buffer);
+    }
+
+    /// \brief Get the maximum encoded buffer size for an unencoded buffer size.
+    /// \param unencodedBufferSize The size of the buffer to be encoded.
+    /// \returns the maximum size of the required encoded buffer.
+    static constexpr size_t getEncodedBufferSize(size_t unencodedBufferSize)
+    {
+        return unencodedBufferSize + unencodedBufferSize / 254 + 1;
+    }
+
+};
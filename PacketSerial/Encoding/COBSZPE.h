@@ -0,0 +1,299 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// \brief A COBS with Zero Pair Elimination (COBS/ZPE) Encoder.
+///
+/// COBS/ZPE splits the code byte range so that a pair of zero bytes costs a
+/// single code byte:
+///
+/// | Code        | Meaning                                      |
+/// |-------------|----------------------------------------------|
+/// | 0x01 - 0xDF | (code - 1) data bytes followed by one zero   |
+/// | 0xE0        | 223 data bytes, not followed by a zero       |
+/// | 0xE1 - 0xFF | (code - 0xE1) data bytes followed by two zeros |
+///
+/// Longer zero runs become one code byte per pair. As with COBS, the frame
+/// is encoded as if it were followed by one extra zero, which the decoder
+/// drops. The encoded data never contains a 0 byte.
+///
+/// This suits the structs in `SensorPacket.h`, which carry padding after
+/// `id`, zero high bytes in small `short` readings and unused fields.
+/// Note that a decoded frame can be up to twice as long as the encoded frame.
+///
+/// \sa http://www.stuartcheshire.org/papers/COBSforToN.pdf
+class COBSZPE
+{
+public:
+    /// \brief Encode a byte buffer with the COBS/ZPE encoder.
+    /// \param buffer A pointer to the unencoded buffer to encode.
+    /// \param size  The number of bytes in the \p buffer.
+    /// \param encodedBuffer The buffer for the encoded bytes.
+    /// \returns The number of bytes written to the \p encodedBuffer.
+    /// \warning The encodedBuffer must have at least getEncodedBufferSize()
+    ///          allocated.
+    static size_t encode(const uint8_t* buffer,
+                         size_t size,
+                         uint8_t* encodedBuffer)
+    {
+        size_t read_index  = 0;
+        size_t write_index = 1;
+        size_t code_index  = 0;
+        uint8_t count      = 0;
+
+        for (;;)
+        {
+            if (read_index < size && buffer[read_index] != 0)
+            {
+                encodedBuffer[write_index++] = buffer[read_index++];
+                count++;
+
+                if (count == MAX_RUN)
+                {
+                    encodedBuffer[code_index] = RUN;
+                    count = 0;
+                    code_index = write_index++;
+                }
+
+                continue;
+            }
+
+            // A zero byte, or the implied zero after the last byte.
+            bool implied = (read_index >= size);
+            read_index++;
+
+            if (!implied && count <= MAX_PAIR_RUN && (read_index == size || buffer[read_index] == 0))
+            {
+                // The second zero of the pair may itself be the implied zero.
+                implied = (read_index == size);
+                read_index++;
+                encodedBuffer[code_index] = PAIR + count;
+            }
+            else
+            {
+                encodedBuffer[code_index] = count + 1;
+            }
+
+            if (implied)
+                break;
+
+            count = 0;
+            code_index = write_index++;
+        }
+
+        return write_index;
+    }
+
+    /// \brief Decode a COBS/ZPE-encoded buffer.
+    /// \param encodedBuffer A pointer to the \p encodedBuffer to decode.
+    /// \param size The number of bytes in the \p encodedBuffer.
+    /// \param decodedBuffer The target buffer for the decoded bytes.
+    /// \returns The number of bytes written to the \p decodedBuffer, or 0 if
+    ///          the \p encodedBuffer is malformed.
+    /// \warning decodedBuffer must have a minimum capacity of 2 * size.
+    static size_t decode(const uint8_t* encodedBuffer,
+                         size_t size,
+                         uint8_t* decodedBuffer)
+    {
+        size_t read_index  = 0;
+        size_t write_index = 0;
+        uint8_t zeros      = 0;
+
+        while (read_index < size)
+        {
+            uint8_t code = encodedBuffer[read_index++];
+
+            if (code == 0)
+            {
+                return 0;
+            }
+
+            uint8_t length = dataLength(code);
+            zeros = zeroCount(code);
+
+            if (length > size - read_index)
+            {
+                return 0;
+            }
+
+            for (uint8_t i = 0; i < length; i++)
+            {
+                decodedBuffer[write_index++] = encodedBuffer[read_index++];
+            }
+
+            for (uint8_t i = 0; i < zeros; i++)
+            {
+                decodedBuffer[write_index++] = '\0';
+            }
+        }
+
+        // Drop the implied zero after the last byte.
+        if (zeros > 0)
+        {
+            write_index--;
+        }
+
+        return write_index;
+    }
+
+    /// \brief Get the maximum encoded buffer size for an unencoded buffer size.
+    /// \param unencodedBufferSize The size of the buffer to be encoded.
+    /// \returns the maximum size of the required encoded buffer.
+    static constexpr size_t getEncodedBufferSize(size_t unencodedBufferSize)
+    {
+        return unencodedBufferSize + unencodedBufferSize / MAX_RUN + 1;
+    }
+
+    /// \brief A byte-at-a-time COBS/ZPE decoder.
+    ///
+    /// Works like COBS::StreamDecoder. One zero of each block is held back
+    /// until the next code byte shows that it was not the implied final zero.
+    class StreamDecoder
+    {
+    public:
+        /// \brief Construct a decoder waiting for the first code byte.
+        StreamDecoder():
+            _remaining(0),
+            _zeros(0),
+            _pendingZero(false),
+            _valid(true)
+        {
+        }
+
+        /// \brief Discard any partially decoded frame.
+        void reset()
+        {
+            _remaining = 0;
+            _zeros = 0;
+            _pendingZero = false;
+            _valid = true;
+        }
+
+        /// \brief Decode the next encoded byte of the frame.
+        /// \param data The next encoded byte.
+        /// \param decodedBuffer The buffer receiving the decoded frame.
+        /// \param decodedSize The number of bytes already in the
+        ///        \p decodedBuffer, advanced by the bytes this call decodes.
+        /// \param capacity The capacity of the \p decodedBuffer.
+        /// \returns false if a decoded byte did not fit in the \p decodedBuffer.
+        bool push(uint8_t data,
+                  uint8_t* decodedBuffer,
+                  size_t& decodedSize,
+                  size_t capacity)
+        {
+            if (_remaining > 0)
+            {
+                _remaining--;
+
+                if (!append(data, decodedBuffer, decodedSize, capacity))
+                    return false;
+
+                return (_remaining > 0) || endBlock(decodedBuffer, decodedSize, capacity);
+            }
+
+            if (data == 0)
+            {
+                _valid = false;
+                return true;
+            }
+
+            if (_pendingZero)
+            {
+                _pendingZero = false;
+
+                if (!append(0, decodedBuffer, decodedSize, capacity))
+                    return false;
+            }
+
+            _remaining = dataLength(data);
+            _zeros = zeroCount(data);
+
+            return (_remaining > 0) || endBlock(decodedBuffer, decodedSize, capacity);
+        }
+
+        /// \brief Complete the frame and prepare for the next one.
+        /// \returns false if the frame was malformed, in which case decode()
+        ///          would have returned 0.
+        bool finish()
+        {
+            bool valid = _valid && (_remaining == 0);
+            reset();
+            return valid;
+        }
+
+    private:
+        /// \brief Emit all but the last zero of a completed block.
+        bool endBlock(uint8_t* decodedBuffer, size_t& decodedSize, size_t capacity)
+        {
+            if (_zeros == 0)
+                return true;
+
+            _pendingZero = true;
+
+            return (_zeros == 1) || append(0, decodedBuffer, decodedSize, capacity);
+        }
+
+        static bool append(uint8_t data,
+                           uint8_t* decodedBuffer,
+                           size_t& decodedSize,
+                           size_t capacity)
+        {
+            if (decodedSize >= capacity)
+                return false;
+
+            decodedBuffer[decodedSize++] = data;
+            return true;
+        }
+
+        uint8_t _remaining;
+        uint8_t _zeros;
+        bool _pendingZero;
+        bool _valid;
+    };
+
+    /// \brief Key constants used in the COBS/ZPE encoding.
+    enum
+    {
+        /// \brief The code for a full block of data with no trailing zero.
+        RUN = 0xE0,
+
+        /// \brief The code for an empty block followed by a zero pair.
+        PAIR = 0xE1,
+
+        /// \brief The number of data bytes in a RUN block.
+        MAX_RUN = RUN - 1,
+
+        /// \brief The most data bytes that can precede a zero pair.
+        MAX_PAIR_RUN = 0xFF - PAIR
+    };
+
+private:
+    static uint8_t dataLength(uint8_t code)
+    {
+        if (code < RUN)
+            return code - 1;
+
+        if (code == RUN)
+            return MAX_RUN;
+
+        return code - PAIR;
+    }
+
+    static uint8_t zeroCount(uint8_t code)
+    {
+        if (code < RUN)
+            return 1;
+
+        if (code == RUN)
+            return 0;
+
+        return 2;
+    }
+
+};
@@ -0,0 +1,65 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../../crc/crc.h"
+
+/// \brief Frame check policies for PacketSerial_.
+///
+/// A frame check accumulates a checksum over the payload bytes as an encoder
+/// reads them. The check value is then appended to the frame as `Size` extra
+/// payload bytes. On receive, the checksum is run over the decoded payload
+/// and its check value together. The frame is intact if valid() returns true.
+///
+/// A frame check class provides:
+///
+///     enum { Size = ... };                            // check value bytes
+///     void reset();                                   // start a new frame
+///     void update(uint8_t data);                      // add one byte
+///     void update(const uint8_t* data, size_t size);  // add several bytes
+///     void get(uint8_t* value) const;                 // check value, wire order
+///     bool valid() const;                             // after payload + value
+///
+/// NoFrameCheck (the default) appends nothing and accepts every frame. Any
+/// CRC from crc.h is also a frame check.
+
+
+/// \brief The default frame check: no check value, every frame is valid.
+class NoFrameCheck
+{
+public:
+    enum { Size = 0 };
+
+    void reset()
+    {
+    }
+
+    void update(uint8_t)
+    {
+    }
+
+    void update(const uint8_t*, size_t)
+    {
+    }
+
+    void get(uint8_t*) const
+    {
+    }
+
+    bool valid() const
+    {
+        return true;
+    }
+};
+
+
+/// \brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), sent big-endian.
+typedef CRC<CRC16CCITT> CRC16FrameCheck;
+
+/// \brief CRC-32 (IEEE 802.3, reflected poly 0xEDB88320), sent little-endian.
+typedef CRC<CRC32IEEE> CRC32FrameCheck;
@@ -0,0 +1,44 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// \brief One piece of a packet that is scattered over several buffers.
+///
+/// Encoders that accept an array of fragments encode them as if they had
+/// been concatenated, without copying them into one buffer first.
+///
+///     PacketFragment fragments[2] = {
+///         { header, sizeof(header) },
+///         { (const uint8_t*)&data, sizeof(data) }
+///     };
+///
+struct PacketFragment
+{
+    /// \brief A pointer to the fragment's bytes.
+    const uint8_t* buffer;
+
+    /// \brief The number of bytes in the \p buffer.
+    size_t size;
+
+    /// \brief Get the total number of bytes in an array of fragments.
+    /// \param fragments A pointer to the fragment array.
+    /// \param count The number of fragments in the array.
+    /// \returns The sum of the fragment sizes.
+    static size_t totalSize(const PacketFragment* fragments, size_t count)
+    {
+        size_t size = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            size += fragments[i].size;
+        }
+
+        return size;
+    }
+};
@@ -0,0 +1,253 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "COBS.h"
+#include "SLIP.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/// \brief Vectorised decode kernels for host-side (x86) gateways.
+///
+/// SIMDCOBS and SIMDSLIP are for host code that has whole encoded frames in
+/// memory, such as a log replay: their decode() copies zero-free /
+/// escape-free runs in bulk. The results are identical to the scalar
+/// decoders, including the 0 returned for a malformed SLIP escape, as
+/// test/simd_fuzz.cpp checks.
+///
+/// They are not faster `EncoderType` classes for `PacketSerial_`. They
+/// inherit COBS's and SLIP's StreamEncoder and StreamDecoder, which
+/// PacketSerial_ always uses when they exist, so `PacketSerial_<SIMDSLIP>`
+/// encodes and decodes exactly like `PacketSerial_<SLIP>` and never calls
+/// the SIMD decode().
+///
+/// On x86 the SLIP kernel searches for END and ESC bytes 16 (SSE2) or 32
+/// (AVX2) bytes at a time; AVX2 is chosen at runtime when the CPU supports
+/// it. On other targets the search falls back to a scalar loop, so these
+/// classes are safe, if pointless, on the TWELITE itself.
+class SIMD
+{
+public:
+    /// \brief Find the first SLIP END or ESC byte in a buffer.
+    /// \param buffer A pointer to the bytes to scan.
+    /// \param size The number of bytes in the \p buffer.
+    /// \returns The index of the first END or ESC byte, or \p size if there
+    ///          is none.
+    static size_t findSLIPSpecial(const uint8_t* buffer, size_t size)
+    {
+        return scanner()(buffer, size);
+    }
+
+    /// \brief Get the name of the kernel selected for this CPU.
+    /// \returns "avx2", "sse2" or "scalar".
+    static const char* kernelName()
+    {
+#if defined(__SSE2__)
+#if defined(__GNUC__)
+        if (scanner() == &scanAVX2)
+            return "avx2";
+#endif
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    typedef size_t (*ScanFunction)(const uint8_t* buffer, size_t size);
+
+    static ScanFunction scanner()
+    {
+        static const ScanFunction function = selectScanner();
+        return function;
+    }
+
+    static ScanFunction selectScanner()
+    {
+#if defined(__SSE2__)
+#if defined(__GNUC__)
+        if (__builtin_cpu_supports("avx2"))
+            return &scanAVX2;
+#endif
+        return &scanSSE2;
+#else
+        return &scanScalar;
+#endif
+    }
+
+    static size_t scanScalar(const uint8_t* buffer, size_t size)
+    {
+        size_t index = 0;
+
+        while (index < size && buffer[index] != SLIP::END && buffer[index] != SLIP::ESC)
+            index++;
+
+        return index;
+    }
+
+#if defined(__SSE2__)
+    static size_t scanSSE2(const uint8_t* buffer, size_t size)
+    {
+        const __m128i end = _mm_set1_epi8((char)SLIP::END);
+        const __m128i esc = _mm_set1_epi8((char)SLIP::ESC);
+
+        size_t index = 0;
+
+        while (index + 16 <= size)
+        {
+            __m128i block = _mm_loadu_si128((const __m128i*)(buffer + index));
+            unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, end),
+                                                                     _mm_cmpeq_epi8(block, esc)));
+            if (mask)
+                return index + __builtin_ctz(mask);
+
+            index += 16;
+        }
+
+        return index + scanScalar(buffer + index, size - index);
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("avx2")))
+    static size_t scanAVX2(const uint8_t* buffer, size_t size)
+    {
+        const __m256i end = _mm256_set1_epi8((char)SLIP::END);
+        const __m256i esc = _mm256_set1_epi8((char)SLIP::ESC);
+
+        size_t index = 0;
+
+        while (index + 32 <= size)
+        {
+            __m256i block = _mm256_loadu_si256((const __m256i*)(buffer + index));
+            unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, end),
+                                                                           _mm256_cmpeq_epi8(block, esc)));
+            if (mask)
+                return index + __builtin_ctz(mask);
+
+            index += 32;
+        }
+
+        return index + scanSSE2(buffer + index, size - index);
+    }
+#endif
+#endif
+};
+
+
+/// \brief A COBS encoder whose decoder copies each block in bulk.
+///
+/// COBS blocks carry their own length, so no search is needed; each block is
+/// moved with a single memcpy(), which the C library already vectorises.
+/// Only decode() differs from COBS, see SIMD.
+class SIMDCOBS: public COBS
+{
+public:
+    /// \brief Decode a COBS-encoded buffer.
+    /// \param encodedBuffer A pointer to the \p encodedBuffer to decode.
+    /// \param size The number of bytes in the \p encodedBuffer.
+    /// \param decodedBuffer The target buffer for the decoded bytes.
+    /// \returns The number of bytes written to the \p decodedBuffer.
+    /// \warning decodedBuffer must have a minimum capacity of size.
+    static size_t decode(const uint8_t* encodedBuffer,
+                         size_t size,
+                         uint8_t* decodedBuffer)
+    {
+        if (size == 0)
+            return 0;
+
+        size_t read_index  = 0;
+        size_t write_index = 0;
+
+        while (read_index < size)
+        {
+            uint8_t code = encodedBuffer[read_index];
+
+            if (read_index + code > size && code != 1)
+            {
+                return 0;
+            }
+
+            read_index++;
+
+            if (code > 1)
+            {
+                memcpy(decodedBuffer + write_index, encodedBuffer + read_index, code - 1);
+                write_index += code - 1;
+                read_index += code - 1;
+            }
+
+            if (code != 0xFF && read_index != size)
+            {
+                decodedBuffer[write_index++] = '\0';
+            }
+        }
+
+        return write_index;
+    }
+};
+
+
+/// \brief A SLIP encoder whose decoder searches for END / ESC with SIMD.
+///
+/// Only decode() differs from SLIP, see SIMD.
+class SIMDSLIP: public SLIP
+{
+public:
+    /// \brief Decode a SLIP-encoded buffer.
+    /// \param encodedBuffer A pointer to the \p encodedBuffer to decode.
+    /// \param size The number of bytes in the \p encodedBuffer.
+    /// \param decodedBuffer The target buffer for the decoded bytes.
+    /// \returns The number of bytes written to the \p decodedBuffer, or 0 if
+    ///          an ESC byte is not followed by ESC_END or ESC_ESC.
+    /// \warning decodedBuffer must have a minimum capacity of size.
+    static size_t decode(const uint8_t* encodedBuffer,
+                         size_t size,
+                         uint8_t* decodedBuffer)
+    {
+        size_t read_index  = 0;
+        size_t write_index = 0;
+
+        while (read_index < size)
+        {
+            size_t run = SIMD::findSLIPSpecial(encodedBuffer + read_index, size - read_index);
+
+            memcpy(decodedBuffer + write_index, encodedBuffer + read_index, run);
+            write_index += run;
+            read_index += run;
+
+            if (read_index == size)
+                break;
+
+            if (encodedBuffer[read_index] == END)
+            {
+                // flush or done
+                read_index++;
+            }
+            else if (read_index + 1 < size && encodedBuffer[read_index + 1] == ESC_END)
+            {
+                decodedBuffer[write_index++] = END;
+                read_index += 2;
+            }
+            else if (read_index + 1 < size && encodedBuffer[read_index + 1] == ESC_ESC)
+            {
+                decodedBuffer[write_index++] = ESC;
+                read_index += 2;
+            }
+            else
+            {
+                // This case is considered a protocol violation.
+                return 0;
+            }
+        }
+
+        return write_index;
+    }
+};
@@ -8,6 +8,11 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+#include "PacketFragment.h"
+#include "FrameCheck.h"
+
 /// \brief A Serial Line Internet Protocol (SLIP) Encoder.
 ///
 /// Serial Line Internet Protocol (SLIP) is a packet framing protocol: SLIP 
@@ -64,55 +69,340 @@ public:
         return write_index;
     }
 
+    /// \brief Encode a packet scattered over several buffers.
+    ///
+    /// Produces the same output as encode() on the concatenated fragments.
+    ///
+    /// \param fragments A pointer to the array of fragments to encode.
+    /// \param count The number of fragments in the array.
+    /// \param encodedBuffer The buffer for the encoded bytes.
+    /// \returns The number of bytes written to the \p encodedBuffer.
+    /// \warning The encodedBuffer must have at least getEncodedBufferSize()
+    ///          of the total fragment size allocated.
+    static size_t encode(const PacketFragment* fragments,
+                         size_t count,
+                         uint8_t* encodedBuffer)
+    {
+        if (PacketFragment::totalSize(fragments, count) == 0)
+            return 0;
+
+        size_t write_index = 0;
+
+        // Double-ENDed, flush any data that may have accumulated due to line 
+        // noise.
+        encodedBuffer[write_index++] = END;
+
+        for (size_t fragment = 0; fragment < count; fragment++)
+        {
+            const uint8_t* buffer = fragments[fragment].buffer;
+            size_t size = fragments[fragment].size;
+
+            for (size_t read_index = 0; read_index < size; read_index++)
+            {
+                if(buffer[read_index] == END)
+                {
+                    encodedBuffer[write_index++] = ESC;
+                    encodedBuffer[write_index++] = ESC_END;
+                }
+                else if(buffer[read_index] == ESC)
+                {
+                    encodedBuffer[write_index++] = ESC;
+                    encodedBuffer[write_index++] = ESC_ESC;
+                }
+                else
+                {
+                    encodedBuffer[write_index++] = buffer[read_index];
+                }
+            }
+        }
+
+        return write_index;
+    }
+
+    /// \brief A SLIP encoder that writes straight to a stream.
+    ///
+    /// The bytes written are the same as those produced by encode(), without
+    /// the need for an encode buffer. The stream may be any object with a
+    /// `write(uint8_t)` method, e.g. `Serial`.
+    class StreamEncoder
+    {
+    public:
+        /// \brief Encode a byte buffer to a stream.
+        /// \param buffer A pointer to the unencoded buffer to encode.
+        /// \param size  The number of bytes in the \p buffer.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType>
+        static size_t encode(const uint8_t* buffer,
+                             size_t size,
+                             StreamType& stream)
+        {
+            NoFrameCheck frameCheck;
+            return encode(buffer, size, stream, frameCheck);
+        }
+
+        /// \brief Encode a packet scattered over several buffers to a stream.
+        /// \param fragments A pointer to the array of fragments to encode.
+        /// \param count The number of fragments in the array.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType>
+        static size_t encode(const PacketFragment* fragments,
+                             size_t count,
+                             StreamType& stream)
+        {
+            NoFrameCheck frameCheck;
+            return encode(fragments, count, stream, frameCheck);
+        }
+
+        /// \brief Encode a byte buffer and its check value to a stream.
+        /// \param buffer A pointer to the unencoded buffer to encode.
+        /// \param size  The number of bytes in the \p buffer.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \param frameCheck The frame check to compute and append, e.g.
+        ///        CRC16FrameCheck. It must be reset.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType, typename FrameCheckType>
+        static size_t encode(const uint8_t* buffer,
+                             size_t size,
+                             StreamType& stream,
+                             FrameCheckType& frameCheck)
+        {
+            PacketFragment fragment = { buffer, size };
+            return encode(&fragment, 1, stream, frameCheck);
+        }
+
+        /// \brief Encode a scattered packet and its check value to a stream.
+        ///
+        /// The check value is updated with each byte as it is escaped, and is
+        /// escaped and written after the last fragment.
+        ///
+        /// \param fragments A pointer to the array of fragments to encode.
+        /// \param count The number of fragments in the array.
+        /// \param stream The stream receiving the encoded bytes.
+        /// \param frameCheck The frame check to compute and append, e.g.
+        ///        CRC16FrameCheck. It must be reset.
+        /// \returns The number of bytes written to the \p stream.
+        template<typename StreamType, typename FrameCheckType>
+        static size_t encode(const PacketFragment* fragments,
+                             size_t count,
+                             StreamType& stream,
+                             FrameCheckType& frameCheck)
+        {
+            if (PacketFragment::totalSize(fragments, count) == 0)
+                return 0;
+
+            size_t written = 1;
+
+            // Double-ENDed, flush any data that may have accumulated due to
+            // line noise.
+            stream.write((uint8_t)END);
+
+            for (size_t fragment = 0; fragment < count; fragment++)
+            {
+                const uint8_t* buffer = fragments[fragment].buffer;
+                size_t size = fragments[fragment].size;
+
+                for (size_t read_index = 0; read_index < size; read_index++)
+                {
+                    frameCheck.update(buffer[read_index]);
+                    written += write(buffer[read_index], stream);
+                }
+            }
+
+            uint8_t check[FrameCheckType::Size + 1] = { 0 };
+            frameCheck.get(check);
+
+            for (size_t i = 0; i < (size_t)FrameCheckType::Size; i++)
+            {
+                written += write(check[i], stream);
+            }
+
+            return written;
+        }
+
+    private:
+        /// \brief Write one byte, escaped if needed.
+        /// \returns The number of bytes written.
+        template<typename StreamType>
+        static size_t write(uint8_t data, StreamType& stream)
+        {
+            if (data == END)
+            {
+                stream.write((uint8_t)ESC);
+                stream.write((uint8_t)ESC_END);
+                return 2;
+            }
+            else if (data == ESC)
+            {
+                stream.write((uint8_t)ESC);
+                stream.write((uint8_t)ESC_ESC);
+                return 2;
+            }
+
+            stream.write(data);
+            return 1;
+        }
+    };
+
     /// \brief Decode a SLIP-encoded buffer.
+    ///
+    /// Every byte is read exactly once, so malformed input cannot stall the
+    /// decoder. An ESC byte that is not followed by ESC_END or ESC_ESC, or an
+    /// ESC at the very end of the buffer, is a protocol violation.
+    ///
     /// \param encodedBuffer A pointer to the \p encodedBuffer to decode.
     /// \param size The number of bytes in the \p encodedBuffer.
     /// \param decodedBuffer The target buffer for the decoded bytes.
-    /// \returns The number of bytes written to the \p decodedBuffer.
+    /// \returns The number of bytes written to the \p decodedBuffer, or 0 on
+    ///          a protocol violation.
     /// \warning decodedBuffer must have a minimum capacity of size.
     static size_t decode(const uint8_t* encodedBuffer,
                          size_t size,
                          uint8_t* decodedBuffer)
     {
-        if (size == 0)
-            return 0;
-
         size_t read_index  = 0;
         size_t write_index = 0;
+        bool escaped       = false;
 
         while (read_index < size)
         {
-            if (encodedBuffer[read_index] == END)
-            {
-                // flush or done
-                read_index++;
-            }
-            else if (encodedBuffer[read_index] == ESC)
+            uint8_t data = encodedBuffer[read_index++];
+
+            if (escaped)
             {
-                if (encodedBuffer[read_index+1] == ESC_END)
+                escaped = false;
+
+                if (data == ESC_END)
                 {
                     decodedBuffer[write_index++] = END;
-                    read_index += 2;
                 }
-                else if (encodedBuffer[read_index+1] == ESC_ESC)
+                else if (data == ESC_ESC)
                 {
                     decodedBuffer[write_index++] = ESC;
-                    read_index += 2;
                 }
                 else
                 {
                     // This case is considered a protocol violation.
+                    return 0;
                 }
             }
+            else if (data == END)
+            {
+                // flush or done
+            }
+            else if (data == ESC)
+            {
+                escaped = true;
+            }
             else
             {
-                decodedBuffer[write_index++] = encodedBuffer[read_index++];
+                decodedBuffer[write_index++] = data;
             }
         }
 
-        return write_index;
+        return escaped ? 0 : write_index;
     }
 
+    /// \brief Decode a SLIP-encoded buffer in place.
+    ///
+    /// The decoded output is never longer than the input and decode() never
+    /// writes ahead of the byte it is reading, so the \p buffer can be used as
+    /// both source and destination.
+    ///
+    /// \param buffer A pointer to the encoded buffer, overwritten with the
+    ///        decoded bytes.
+    /// \param size The number of bytes in the \p buffer.
+    /// \returns The number of decoded bytes at the start of the \p buffer.
+    static size_t decodeInPlace(uint8_t* buffer, size_t size)
+    {
+        return decode(buffer, size, buffer);
+    }
+
+    /// \brief A byte-at-a-time SLIP decoder.
+    ///
+    /// The same state machine as decode(), fed one byte at a time. A protocol
+    /// violation marks the frame as malformed; decoding continues with the
+    /// next byte so the decoder stays in step with the stream.
+    class StreamDecoder
+    {
+    public:
+        /// \brief Construct a decoder at the start of a frame.
+        StreamDecoder():
+            _escaped(false),
+            _valid(true)
+        {
+        }
+
+        /// \brief Discard any partially decoded frame.
+        void reset()
+        {
+            _escaped = false;
+            _valid = true;
+        }
+
+        /// \brief Decode the next encoded byte of the frame.
+        /// \param data The next encoded byte.
+        /// \param decodedBuffer The buffer receiving the decoded frame.
+        /// \param decodedSize The number of bytes already in the
+        ///        \p decodedBuffer, advanced by the bytes this call decodes.
+        /// \param capacity The capacity of the \p decodedBuffer.
+        /// \returns false if a decoded byte did not fit in the \p decodedBuffer.
+        bool push(uint8_t data,
+                  uint8_t* decodedBuffer,
+                  size_t& decodedSize,
+                  size_t capacity)
+        {
+            if (_escaped)
+            {
+                _escaped = false;
+
+                if (data == ESC_END)
+                {
+                    data = END;
+                }
+                else if (data == ESC_ESC)
+                {
+                    data = ESC;
+                }
+                else
+                {
+                    _valid = false;
+                    return true;
+                }
+            }
+            else if (data == END)
+            {
+                return true;
+            }
+            else if (data == ESC)
+            {
+                _escaped = true;
+                return true;
+            }
+
+            if (decodedSize >= capacity)
+                return false;
+
+            decodedBuffer[decodedSize++] = data;
+            return true;
+        }
+
+        /// \brief Complete the frame and prepare for the next one.
+        /// \returns false if the frame contained a protocol violation, in
+        ///          which case decode() would have returned 0.
+        bool finish()
+        {
+            bool valid = _valid && !_escaped;
+            reset();
+            return valid;
+        }
+
+    private:
+        bool _escaped;
+        bool _valid;
+    };
+
     /// \brief Get the maximum encoded buffer size for an unencoded buffer size.
     ///
     /// SLIP has a start and end markers (192 and 219). Marker value is
@@ -122,7 +412,7 @@ public:
     ///
     /// \param unencodedBufferSize The size of the buffer to be encoded.
     /// \returns the maximum size of the required encoded buffer.
-    static size_t getEncodedBufferSize(size_t unencodedBufferSize)
+    static constexpr size_t getEncodedBufferSize(size_t unencodedBufferSize)
     {
         return unencodedBufferSize * 2 + 2;
     }
@@ -0,0 +1,204 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include "PacketSerial.h"
+
+/// \brief Packs small records into one frame to save per-frame overhead.
+///
+/// Each record in a frame is prefixed with its length in one byte:
+///
+///     [size][record][size][record]...
+///
+/// so a 9-byte `VaneData` costs 10 bytes inside a shared frame instead of
+/// its own marker and encoding overhead. Records are collected until the
+/// next one would not fit in `Size` bytes, or until the oldest has waited
+/// `maxDelayMicros`, and then sent with `link.send(buffer, size)`.
+///
+///     PacketSerial link;
+///     PacketAggregator<PacketSerial, 128> aggregator(link, 2000);
+///
+///     void loop()
+///     {
+///         aggregator.add(vaneData);
+///         aggregator.add(ultraSonicData);
+///
+///         aggregator.update();
+///         link.update();
+///     }
+///
+/// The receiver unpacks the frames with a PacketSplitter.
+///
+/// \tparam LinkType A PacketSerial_, or any class with
+///         `bool send(const uint8_t*, size_t)`.
+/// \tparam Size The largest frame to send, in bytes. The encoded frame must
+///         fit in the receiver's receive buffer.
+template<typename LinkType, size_t Size>
+class PacketAggregator
+{
+public:
+    static_assert(Size >= 2 && Size <= 65535, "the aggregate frame size must be between 2 and 65535 bytes");
+
+    /// \brief Construct an aggregator sending on the given link.
+    /// \param link The link to send the frames on.
+    /// \param maxDelayMicros The longest a record waits before update()
+    ///        sends its frame.
+    PacketAggregator(LinkType& link, uint32_t maxDelayMicros):
+        _link(link),
+        _maxDelayMicros(maxDelayMicros),
+        _size(0),
+        _firstMicros(0)
+    {
+    }
+
+    /// \brief Add a record to the frame being collected.
+    ///
+    /// If the record does not fit, the frame collected so far is sent
+    /// first. A frame that is exactly full is sent straight away.
+    ///
+    /// \param record A pointer to the record.
+    /// \param size The number of bytes in the record, 1 to 255.
+    /// \returns false if the record is too large, or a frame had to be sent
+    ///          and was dropped.
+    bool add(const uint8_t* record, size_t size)
+    {
+        if (record == nullptr || size == 0 || size > 255 || size + 1 > Size)
+            return false;
+
+        bool sent = true;
+
+        if (_size + 1 + size > Size)
+            sent = flush();
+
+        if (_size == 0)
+            _firstMicros = PacketSerialMicros();
+
+        _buffer[_size++] = (uint8_t)size;
+        memcpy(_buffer + _size, record, size);
+        _size += size;
+
+        if (_size == Size)
+            sent = flush() && sent;
+
+        return sent;
+    }
+
+    /// \brief Add a fixed-size record, such as a `DeviceData` struct.
+    /// \param record The record to add.
+    template<typename T>
+    bool add(const T& record)
+    {
+        static_assert(!PacketSerialIsPointer<T>::value, "add(const T&) adds the pointer itself; use add(record, size)");
+        static_assert(PacketSerialIsTriviallyCopyable<T>::value, "add(const T&) needs a trivially copyable type");
+        static_assert(sizeof(T) <= 255 && sizeof(T) + 1 <= Size, "the record does not fit in an aggregate frame");
+
+        return add(reinterpret_cast<const uint8_t*>(&record), sizeof(T));
+    }
+
+    /// \brief Send the frame if its oldest record has waited long enough.
+    ///
+    /// Call this often, e.g. once per `loop()`.
+    void update()
+    {
+        if (_size > 0 && (uint32_t)(PacketSerialMicros() - _firstMicros) >= _maxDelayMicros)
+            flush();
+    }
+
+    /// \brief Send the records collected so far.
+    /// \returns false if the frame was dropped. Empty frames are not sent.
+    bool flush()
+    {
+        if (_size == 0)
+            return true;
+
+        bool sent = _link.send(_buffer, _size);
+        _size = 0;
+
+        return sent;
+    }
+
+    /// \returns the number of bytes waiting to be sent.
+    size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    PacketAggregator(const PacketAggregator&);
+    PacketAggregator& operator = (const PacketAggregator&);
+
+    LinkType& _link;
+    uint32_t _maxDelayMicros;
+    uint8_t _buffer[Size];
+    size_t _size;
+    uint32_t _firstMicros;
+};
+
+/// \brief Unpacks frames built by a PacketAggregator.
+///
+/// A functor taking `(buffer, size)`, so it can be the `HandlerType` of a
+/// PacketSerial_. It calls its own handler once per record:
+///
+///     typedef DeviceData::Router<Logger, DeviceData::VaneData, DeviceData::UltraSonicData> Router;
+///
+///     PacketSerial_<COBS, 0, 256, false, NoFrameCheck, PacketSerialOptions<PacketSplitter<Router> > > link;
+///
+/// A frame whose last length prefix runs past its end is malformed. The
+/// records before it are still delivered, and the frame is counted in
+/// malformedCount().
+///
+/// \tparam HandlerType A functor type, called as `handler(record, size)`.
+template<typename HandlerType>
+class PacketSplitter
+{
+public:
+    PacketSplitter():
+        _malformedCount(0)
+    {
+    }
+
+    explicit PacketSplitter(const HandlerType& handler):
+        _handler(handler),
+        _malformedCount(0)
+    {
+    }
+
+    /// \brief Deliver each record of one frame.
+    void operator()(const uint8_t* buffer, size_t size)
+    {
+        size_t index = 0;
+
+        while (index < size)
+        {
+            size_t recordSize = buffer[index++];
+
+            if (recordSize == 0 || recordSize > size - index)
+            {
+                _malformedCount++;
+                return;
+            }
+
+            _handler(buffer + index, recordSize);
+            index += recordSize;
+        }
+    }
+
+    /// \brief Get the record handler, e.g. to update its state.
+    HandlerType& handler()
+    {
+        return _handler;
+    }
+
+    /// \returns the number of malformed frames since construction.
+    size_t malformedCount() const
+    {
+        return _malformedCount;
+    }
+
+private:
+    HandlerType _handler;
+    size_t _malformedCount;
+};
@@ -0,0 +1,401 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include "PacketSerial.h"
+
+/// \brief Credit-based flow control on top of PacketSerial_.
+///
+/// The receiver (e.g. the PC gateway) tells the sender (e.g. the master)
+/// how many frames it can still take. The sender only sends while it has
+/// credits, so a stalled receiver makes the sender hold or drop frames
+/// instead of the receiver's driver losing bytes in the middle of frames.
+///
+/// Credits travel in grant frames on the same link, 8 bytes, big-endian:
+///
+///     [0xF0][epoch][space:16][received:32]
+///
+/// where `received` is the number of data frames the receiver has counted
+/// and `space` the number it can still buffer. 0xF0 is not a DeviceID type,
+/// so grants can share a link with `DeviceData` frames. The sender's
+/// credits are `space` minus the frames it sent that `received` does not
+/// cover yet. Grants are absolute, so a lost grant is made good by the next
+/// one.
+///
+/// `epoch` changes when the receiver restarts and counts from 0 again. The
+/// sender then starts counting from the new receiver's `received`. Frames
+/// the sender had in flight at that moment reach the new receiver without
+/// a credit, so just after a restart the receiver can get up to one window
+/// more than it granted.
+///
+/// A frame the receiver never counts keeps its credit in use until the
+/// next epoch. The receiver should therefore also count frames it drops
+/// for decode or check errors. Only frames lost without a trace, such as
+/// two frames merged by a lost marker, still cost a credit.
+struct PacketCreditGrant
+{
+    enum
+    {
+        /// \brief The first byte of a grant frame.
+        ID = 0xF0,
+
+        /// \brief The size of a grant frame.
+        Size = 8
+    };
+
+    /// \brief Build a grant frame.
+    static void encode(uint8_t* buffer, uint8_t epoch, uint16_t space, uint32_t received)
+    {
+        buffer[0] = ID;
+        buffer[1] = epoch;
+        buffer[2] = (uint8_t)(space >> 8);
+        buffer[3] = (uint8_t)space;
+        buffer[4] = (uint8_t)(received >> 24);
+        buffer[5] = (uint8_t)(received >> 16);
+        buffer[6] = (uint8_t)(received >> 8);
+        buffer[7] = (uint8_t)received;
+    }
+
+    /// \brief Read a grant frame.
+    /// \returns false if the frame is not a grant.
+    static bool decode(const uint8_t* buffer, size_t size, uint8_t& epoch, uint16_t& space, uint32_t& received)
+    {
+        if (size != Size || buffer[0] != ID)
+            return false;
+
+        epoch = buffer[1];
+        space = (uint16_t)(buffer[2] << 8 | buffer[3]);
+        received = (uint32_t)buffer[4] << 24 | (uint32_t)buffer[5] << 16 | (uint32_t)buffer[6] << 8 | buffer[7];
+        return true;
+    }
+};
+
+/// \brief The sending side of credit flow control.
+///
+/// Sends through a link only while the receiver has granted credits. Out
+/// of credits, a frame is either dropped (telemetry that will be stale by
+/// the time it could go) or held in a buffer of `HoldSize` bytes and sent
+/// by update() once credits arrive.
+///
+///     PacketSerial link;
+///     PacketCreditSender<PacketSerial, 256> credit(link);
+///
+///     void onPacketReceived(const uint8_t* buffer, size_t size)
+///     {
+///         if (credit.receive(buffer, size))
+///             return;
+///
+///         // Not a grant: handle the packet.
+///     }
+///
+///     void loop()
+///     {
+///         credit.send(imuData);                                    // dropped when out
+///         credit.send(servoData, credit.HOLD_WHEN_OUT);            // held when out
+///
+///         credit.update();
+///         link.update();
+///     }
+///
+/// \tparam LinkType A PacketSerial_, or any class with
+///         `bool send(const uint8_t*, size_t)`.
+/// \tparam HoldSize The number of bytes for held frames, each stored with a
+///         one-byte length. If 0, frames can only be dropped.
+template<typename LinkType, size_t HoldSize = 0>
+class PacketCreditSender
+{
+public:
+    /// \brief What send() does without credits.
+    enum CreditPolicy
+    {
+        /// \brief Drop the frame and count it in dropCount().
+        DROP_WHEN_OUT,
+
+        /// \brief Keep the frame for update(), or drop it if the hold
+        /// buffer is full.
+        HOLD_WHEN_OUT
+    };
+
+    /// \brief Construct a sender on the given link.
+    ///
+    /// There are no credits until the first grant arrives.
+    explicit PacketCreditSender(LinkType& link):
+        _link(link),
+        _sent(0),
+        _received(0),
+        _space(0),
+        _epoch(0),
+        _granted(false),
+        _holdSize(0),
+        _dropCount(0)
+    {
+    }
+
+    /// \brief Send a frame if there is a credit for it.
+    /// \param buffer A pointer to the frame.
+    /// \param size The number of bytes in the frame.
+    /// \param policy What to do without a credit.
+    /// \returns true if the frame was sent or held.
+    bool send(const uint8_t* buffer, size_t size, CreditPolicy policy = DROP_WHEN_OUT)
+    {
+        if (buffer == nullptr || size == 0)
+            return false;
+
+        // Held frames go first, to keep the order. Once they are out, a
+        // remaining credit is for this frame, whatever its policy.
+        update();
+
+        if (_holdSize == 0 && credits() > 0)
+            return _send(buffer, size);
+
+        if (policy == HOLD_WHEN_OUT && _hold(buffer, size))
+            return true;
+
+        _dropCount++;
+        return false;
+    }
+
+    /// \brief Send a fixed-size frame, such as a `DeviceData` struct.
+    template<typename T>
+    bool send(const T& packet, CreditPolicy policy = DROP_WHEN_OUT)
+    {
+        static_assert(!PacketSerialIsPointer<T>::value, "send(const T&) sends the pointer itself; use send(buffer, size)");
+        static_assert(PacketSerialIsTriviallyCopyable<T>::value, "send(const T&) needs a trivially copyable type");
+
+        return send(reinterpret_cast<const uint8_t*>(&packet), sizeof(T), policy);
+    }
+
+    /// \brief Take the credits from a received frame, if it is a grant.
+    ///
+    /// Call this first from the link's packet handler.
+    ///
+    /// \returns true if the frame was a grant, and needs no other handling.
+    bool receive(const uint8_t* buffer, size_t size)
+    {
+        uint8_t epoch;
+        uint16_t space;
+        uint32_t received;
+
+        if (!PacketCreditGrant::decode(buffer, size, epoch, space, received))
+            return false;
+
+        // A first grant, or a receiver that restarted: nothing was sent to
+        // it yet, so count on from its total.
+        if (!_granted || epoch != _epoch)
+            _sent = received;
+
+        // The receiver counted more frames than were sent, e.g. line noise
+        // dropped as decode errors. Never count back.
+        if ((int32_t)(_sent - received) < 0)
+            _sent = received;
+
+        _received = received;
+        _space = space;
+        _epoch = epoch;
+        _granted = true;
+
+        return true;
+    }
+
+    /// \brief Send held frames while there are credits.
+    ///
+    /// A frame the link does not take, e.g. with its transmit queue full,
+    /// stays held for the next update().
+    ///
+    /// Call this often, e.g. once per `loop()`.
+    void update()
+    {
+        while (_holdSize > 0 && credits() > 0)
+        {
+            size_t size = _holdBuffer[0];
+
+            if (!_send(_holdBuffer + 1, size))
+                break;
+
+            _holdSize -= size + 1;
+            memmove(_holdBuffer, _holdBuffer + size + 1, _holdSize);
+        }
+    }
+
+    /// \returns the number of frames that can be sent now.
+    size_t credits() const
+    {
+        uint32_t inFlight = _sent - _received;
+        return inFlight < _space ? _space - inFlight : 0;
+    }
+
+    /// \returns the number of bytes of held frames.
+    size_t holdSize() const
+    {
+        return _holdSize;
+    }
+
+    /// \returns the number of frames dropped for lack of credits since
+    ///          construction.
+    size_t dropCount() const
+    {
+        return _dropCount;
+    }
+
+private:
+    PacketCreditSender(const PacketCreditSender&);
+    PacketCreditSender& operator = (const PacketCreditSender&);
+
+    bool _send(const uint8_t* buffer, size_t size)
+    {
+        // A frame the link drops never reaches the receiver either, so it
+        // costs no credit.
+        if (!_link.send(buffer, size))
+            return false;
+
+        _sent++;
+        return true;
+    }
+
+    bool _hold(const uint8_t* buffer, size_t size)
+    {
+        if (size > 255 || _holdSize + 1 + size > HoldSize)
+            return false;
+
+        _holdBuffer[_holdSize] = (uint8_t)size;
+        memcpy(_holdBuffer + _holdSize + 1, buffer, size);
+        _holdSize += size + 1;
+
+        return true;
+    }
+
+    LinkType& _link;
+    uint32_t _sent;
+    uint32_t _received;
+    uint16_t _space;
+    uint8_t _epoch;
+    bool _granted;
+    uint8_t _holdBuffer[HoldSize > 0 ? HoldSize : 1];
+    size_t _holdSize;
+    size_t _dropCount;
+};
+
+/// \brief The receiving side of credit flow control.
+///
+/// Counts the data frames that arrive and sends grants back on the same
+/// link: every `intervalMillis`, and as soon as a grant would give the
+/// sender back half the window.
+///
+///     PacketCreditReceiver<PacketSerial> credit(link, 64, 50, (uint8_t)time(nullptr));
+///
+///     void onPacket(const uint8_t* buffer, size_t size)
+///     {
+///         credit.received();
+///         queue.push(buffer, size);
+///     }
+///
+///     // Frames dropped by update() for decode or check errors:
+///     credit.received(errors);
+///     credit.consumed(errors);
+///
+///     // Once a queued frame has been written out:
+///     credit.consumed();
+///
+/// \tparam LinkType A PacketSerial_, or any class with
+///         `bool send(const uint8_t*, size_t)`.
+template<typename LinkType>
+class PacketCreditReceiver
+{
+public:
+    /// \brief Construct a receiver on the given link.
+    /// \param link The link to send grants on.
+    /// \param window The number of frames the receiver can buffer.
+    /// \param intervalMillis The longest time between two grants.
+    /// \param epoch A value that differs from the one before the receiver
+    ///        last restarted, e.g. from the time or a boot counter. See
+    ///        PacketCreditGrant.
+    PacketCreditReceiver(LinkType& link, uint16_t window, uint32_t intervalMillis, uint8_t epoch):
+        _link(link),
+        _window(window),
+        _intervalMillis(intervalMillis),
+        _epoch(epoch),
+        _received(0),
+        _consumed(0),
+        _grantedSpace(0),
+        _grantedReceived(0),
+        _lastGrant(0),
+        _granted(false)
+    {
+    }
+
+    /// \brief Count data frames that arrived.
+    /// \param count The number of frames.
+    void received(uint32_t count = 1)
+    {
+        _received += count;
+    }
+
+    /// \brief Free the buffer space of frames that have been handled.
+    /// \param count The number of frames.
+    void consumed(uint32_t count = 1)
+    {
+        _consumed += count;
+    }
+
+    /// \returns the number of frames received but not yet consumed.
+    uint32_t buffered() const
+    {
+        return _received - _consumed;
+    }
+
+    /// \returns the number of frames the receiver can still buffer.
+    uint16_t space() const
+    {
+        uint32_t used = buffered();
+        return used < _window ? (uint16_t)(_window - used) : 0;
+    }
+
+    /// \brief Send a grant if one is due.
+    ///
+    /// Call this often, e.g. once per loop.
+    void update()
+    {
+        uint16_t space = this->space();
+        uint32_t now = PacketSerialMillis();
+
+        // The sender has used one credit per frame since the last grant, so
+        // a new grant gives it back those frames plus any space freed.
+        uint32_t regained = space + (_received - _grantedReceived) - _grantedSpace;
+
+        if (!_granted || (uint32_t)(now - _lastGrant) >= _intervalMillis || (int32_t)regained >= _window / 2)
+            grant();
+    }
+
+    /// \brief Send a grant now.
+    /// \returns false if the grant was dropped.
+    bool grant()
+    {
+        uint8_t buffer[PacketCreditGrant::Size];
+
+        _grantedSpace = space();
+        _grantedReceived = _received;
+        _lastGrant = PacketSerialMillis();
+        _granted = true;
+
+        PacketCreditGrant::encode(buffer, _epoch, _grantedSpace, _received);
+        return _link.send(buffer, sizeof(buffer));
+    }
+
+private:
+    PacketCreditReceiver(const PacketCreditReceiver&);
+    PacketCreditReceiver& operator = (const PacketCreditReceiver&);
+
+    LinkType& _link;
+    uint16_t _window;
+    uint32_t _intervalMillis;
+    uint8_t _epoch;
+    uint32_t _received;
+    uint32_t _consumed;
+    uint16_t _grantedSpace;
+    uint32_t _grantedReceived;
+    uint32_t _lastGrant;
+    bool _granted;
+};
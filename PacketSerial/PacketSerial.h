@@ -7,323 +7,2418 @@
 
 #pragma once
 
+#ifndef PACKETSERIAL_HOST
 #include<TWELITE>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#endif
 #include "Encoding/COBS.h"
+#include "Encoding/COBSR.h"
+#include "Encoding/COBSZPE.h"
 #include "Encoding/SLIP.h"
+#include "Encoding/FrameCheck.h"
 
-/// \brief A template class enabling packet-based Serial communication.
+
+/// \brief The stream a PacketSerial_ uses unless given another one.
 ///
-/// Typically one of the typedefined versions are used, for example,
-/// `COBSPacketSerial` or `SLIPPacketSerial`.
+/// `Serial` if UART0 is defined, `Serial1` otherwise. Host builds, which
+/// define PACKETSERIAL_HOST instead of using the TWELITE SDK, have no default
+/// stream and must pass one to the PacketSerial_ constructor.
+#ifndef PACKETSERIAL_HOST
+#ifdef UART0
+typedef decltype(Serial) PacketSerialDefaultStream;
+#else
+typedef decltype(Serial1) PacketSerialDefaultStream;
+#endif
+#else
+struct PacketSerialDefaultStream;
+#endif
+
+/// \brief The millisecond clock PacketSerial_ measures rates with.
+/// \returns `millis()`, or the monotonic clock in host builds.
+inline uint32_t PacketSerialMillis()
+{
+#ifndef PACKETSERIAL_HOST
+    return millis();
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+#endif
+}
+
+/// \brief The microsecond clock PacketSerialStats times with.
+/// \returns `micros()`, or the monotonic clock in host builds.
+inline uint32_t PacketSerialMicros()
+{
+#ifndef PACKETSERIAL_HOST
+    return micros();
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000000 + now.tv_nsec / 1000);
+#endif
+}
+
+/// \brief Get the default stream, if `StreamType` is its type.
+template<typename StreamType>
+struct PacketSerialStream
+{
+    static StreamType* defaultStream()
+    {
+        return nullptr;
+    }
+};
+
+#ifndef PACKETSERIAL_HOST
+template<>
+struct PacketSerialStream<PacketSerialDefaultStream>
+{
+    static PacketSerialDefaultStream* defaultStream()
+    {
+#ifdef UART0
+        return &Serial;
+#else
+        return &Serial1;
+#endif
+    }
+};
+#endif
+
+/// \brief A compile-time boolean used to select PacketSerial_ code paths.
+template<bool Value>
+struct PacketSerialBool
+{
+};
+
+/// \brief Detect whether an encoder provides a byte-at-a-time decoder.
 ///
-/// The template parameters allow the user to define their own packet encoder /
-/// decoder, custom packet marker and receive buffer size.
+/// An `EncoderType` that defines a nested `StreamDecoder` class (see
+/// COBS::StreamDecoder) is decoded as bytes arrive. Other encoders are
+/// buffered and decoded with `EncoderType::decode()` when the packet marker
+/// is received.
+template<typename EncoderType>
+class PacketSerialHasStreamDecoder
+{
+    template<typename T> static char test(typename T::StreamDecoder*);
+    template<typename T> static long test(...);
+
+public:
+    enum { value = sizeof(test<EncoderType>(0)) == sizeof(char) };
+};
+
+/// \brief Detect whether an encoder can write straight to a stream.
 ///
-/// \tparam EncoderType The static packet encoder class name.
-/// \tparam PacketMarker The byte value used to mark the packet boundary.
-/// \tparam BufferSize The number of bytes allocated for the receive buffer.
-template<typename EncoderType, uint8_t PacketMarker = 0, size_t ReceiveBufferSize = 256>
-class PacketSerial_
+/// An `EncoderType` that defines a nested `StreamEncoder` class (see
+/// COBS::StreamEncoder) is encoded directly to the serial port. Other
+/// encoders are encoded into a temporary stack buffer first.
+///
+/// The `StreamEncoder` must also accept a frame check, which it updates with
+/// each byte it reads and appends after the payload.
+template<typename EncoderType>
+class PacketSerialHasStreamEncoder
 {
+    template<typename T> static char test(typename T::StreamEncoder*);
+    template<typename T> static long test(...);
+
 public:
-    /// \brief A typedef describing the packet handler method.
-    ///
-    /// The packet handler method usually has the form:
-    ///
-    ///     void onPacketReceived(const uint8_t* buffer, size_t size);
-    ///
-    /// where buffer is a pointer to the incoming buffer array, and size is the
-    /// number of bytes in the incoming buffer.
-    typedef void (*PacketHandlerFunction)(const uint8_t* buffer, size_t size);
+    enum { value = sizeof(test<EncoderType>(0)) == sizeof(char) };
+};
+
+/// \brief Detect whether a stream can read several bytes in one call.
+///
+/// A `StreamType` with an Arduino-style `readBytes(uint8_t*, size_t)` is
+/// read a block at a time by PacketSerial_::update(). Other streams are read
+/// with one `read()` call per byte, and the block copy is skipped.
+template<typename StreamType>
+class PacketSerialHasReadBytes
+{
+    template<typename T> static char test(char (*)[sizeof(((T*)0)->readBytes((uint8_t*)0, (size_t)0))]);
+    template<typename T> static long test(...);
+
+public:
+    enum { value = sizeof(test<StreamType>(0)) == sizeof(char) };
+};
+
+/// \brief Detect whether a stream can write several bytes in one call.
+///
+/// A `StreamType` with `write(const uint8_t*, size_t)` is written a block at
+/// a time, so a host tty takes a frame in one or two write() calls instead
+/// of one per byte. Other streams are written one byte per `write()` call.
+template<typename StreamType>
+class PacketSerialHasWriteBytes
+{
+    template<typename T> static char test(char (*)[sizeof(((T*)0)->write((const uint8_t*)0, (size_t)0))]);
+    template<typename T> static long test(...);
+
+public:
+    enum { value = sizeof(test<StreamType>(0)) == sizeof(char) };
+};
+
+/// \brief Detect a pointer type.
+///
+/// Used to reject `send(const T&)` with a pointer, which would send the
+/// pointer's own bytes rather than what it points to.
+template<typename T>
+struct PacketSerialIsPointer
+{
+    enum { value = false };
+};
+
+template<typename T>
+struct PacketSerialIsPointer<T*>
+{
+    enum { value = true };
+};
+
+/// \brief Detect a type that can be sent as its raw bytes.
+///
+/// The typed `send(const T&)` and `add(const T&)` overloads copy
+/// `sizeof(T)` bytes out of the object, which is only meaningful for plain
+/// structs such as `DeviceData` records. Compiler built-ins are used since
+/// the JN516x toolchain predates `<type_traits>`' is_trivially_copyable.
+template<typename T>
+struct PacketSerialIsTriviallyCopyable
+{
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+    enum { value = __is_trivially_copyable(T) };
+#else
+    enum { value = __has_trivial_copy(T) && __has_trivial_destructor(T) };
+#endif
+};
+
+/// \brief The stream decoder stored by PacketSerial_ for an encoder.
+template<typename EncoderType, bool Streaming = PacketSerialHasStreamDecoder<EncoderType>::value>
+struct PacketSerialStreamDecoder
+{
+    /// \brief An empty placeholder for encoders without a stream decoder.
+    struct type
+    {
+    };
+};
+
+template<typename EncoderType>
+struct PacketSerialStreamDecoder<EncoderType, true>
+{
+    typedef typename EncoderType::StreamDecoder type;
+};
+
+/// \brief The ring buffer behind PacketSerial_'s transmit queue.
+///
+/// Bytes of the frame being written can be taken back with rollback() until
+/// the frame is committed.
+template<size_t Size>
+class PacketSerialTransmitQueue
+{
+public:
+    PacketSerialTransmitQueue():
+        _head(0),
+        _size(0),
+        _frameSize(0),
+        _highWaterMark(0)
+    {
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    bool full() const
+    {
+        return _size == Size;
+    }
+
+    size_t highWaterMark() const
+    {
+        return _highWaterMark;
+    }
+
+    /// \brief Append a byte. The queue must not be full.
+    void push(uint8_t data)
+    {
+        size_t tail = _head + _size;
+
+        if (tail >= Size)
+            tail -= Size;
+
+        _buffer[tail] = data;
+        _size++;
+    }
+
+    /// \brief Remove the oldest byte. The queue must not be empty.
+    uint8_t pop()
+    {
+        uint8_t data = _buffer[_head];
+
+        if (++_head == Size)
+            _head = 0;
+
+        _size--;
+
+        // The oldest bytes are always committed ones, if any are left.
+        if (_frameSize > 0)
+            _frameSize--;
+
+        return data;
+    }
+
+    /// \brief Keep the bytes pushed so far.
+    void commit()
+    {
+        _frameSize = _size;
+
+        if (_size > _highWaterMark)
+            _highWaterMark = _size;
+    }
+
+    /// \brief Remove the bytes pushed since the last commit().
+    void rollback()
+    {
+        _size = _frameSize;
+    }
+
+private:
+    uint8_t _buffer[Size];
+    size_t _head;
+    size_t _size;
+    size_t _frameSize;
+    size_t _highWaterMark;
+};
+
+/// \brief The empty transmit queue of an unqueued PacketSerial_.
+template<>
+class PacketSerialTransmitQueue<0>
+{
+public:
+    size_t size() const
+    {
+        return 0;
+    }
+
+    size_t highWaterMark() const
+    {
+        return 0;
+    }
+
+    uint8_t pop()
+    {
+        return 0;
+    }
+};
+
+/// \brief The transmit queues of a PacketSerial_, and the order in which
+/// their bytes go to the serial port.
+///
+/// With a `PriorityBufferSize`, high-priority frames have a queue of their
+/// own. Bytes are taken a frame at a time, a frame ending at the packet
+/// marker. Whenever a frame is finished, a waiting high-priority frame goes
+/// next, ahead of every queued normal frame.
+template<size_t Size, size_t PrioritySize, uint8_t PacketMarker>
+class PacketSerialTransmitQueues
+{
+public:
+    PacketSerialTransmitQueues():
+        _current(NONE)
+    {
+    }
+
+    size_t size() const
+    {
+        return _normal.size() + _priority.size();
+    }
+
+    /// \returns the most bytes the normal queue has held.
+    size_t highWaterMark() const
+    {
+        return _normal.highWaterMark();
+    }
+
+    /// \returns the most bytes the high-priority queue has held.
+    size_t priorityHighWaterMark() const
+    {
+        return _priority.highWaterMark();
+    }
+
+    bool full(bool priority) const
+    {
+        return priority ? _priority.full() : _normal.full();
+    }
+
+    void push(bool priority, uint8_t data)
+    {
+        if (priority)
+            _priority.push(data);
+        else
+            _normal.push(data);
+    }
+
+    void commit(bool priority)
+    {
+        if (priority)
+            _priority.commit();
+        else
+            _normal.commit();
+    }
+
+    void rollback(bool priority)
+    {
+        if (priority)
+            _priority.rollback();
+        else
+            _normal.rollback();
+    }
+
+    /// \brief Remove the next byte to send. The queues must not both be
+    /// empty.
+    uint8_t pop()
+    {
+        if (_current == NONE || (_current == NORMAL ? _normal.size() : _priority.size()) == 0)
+            _current = _priority.size() > 0 ? PRIORITY : NORMAL;
+
+        uint8_t data = (_current == PRIORITY) ? _priority.pop() : _normal.pop();
+
+        if (data == PacketMarker)
+            _current = NONE;
+
+        return data;
+    }
+
+private:
+    enum Current
+    {
+        NONE,
+        NORMAL,
+        PRIORITY
+    };
+
+    PacketSerialTransmitQueue<Size> _normal;
+    PacketSerialTransmitQueue<PrioritySize> _priority;
+    Current _current;
+};
+
+/// \brief A single transmit queue, sent in order.
+template<size_t Size, uint8_t PacketMarker>
+class PacketSerialTransmitQueues<Size, 0, PacketMarker>
+{
+public:
+    size_t size() const
+    {
+        return _queue.size();
+    }
+
+    size_t highWaterMark() const
+    {
+        return _queue.highWaterMark();
+    }
+
+    size_t priorityHighWaterMark() const
+    {
+        return 0;
+    }
+
+    bool full(bool) const
+    {
+        return _queue.full();
+    }
+
+    void push(bool, uint8_t data)
+    {
+        _queue.push(data);
+    }
+
+    void commit(bool)
+    {
+        _queue.commit();
+    }
+
+    void rollback(bool)
+    {
+        _queue.rollback();
+    }
+
+    uint8_t pop()
+    {
+        return _queue.pop();
+    }
+
+private:
+    PacketSerialTransmitQueue<Size> _queue;
+};
+
+/// \brief The empty transmit queues of an unqueued PacketSerial_.
+template<uint8_t PacketMarker>
+class PacketSerialTransmitQueues<0, 0, PacketMarker>
+{
+public:
+    size_t size() const
+    {
+        return 0;
+    }
+
+    size_t highWaterMark() const
+    {
+        return 0;
+    }
+
+    size_t priorityHighWaterMark() const
+    {
+        return 0;
+    }
+
+    uint8_t pop()
+    {
+        return 0;
+    }
+};
+
+/// \brief The stream an encoder writes a queued frame to.
+///
+/// When the queue is full, the writer either makes room by writing the
+/// next scheduled byte to the serial port, or stops and has the frame
+/// rolled back.
+template<typename QueuesType, typename StreamType>
+class PacketSerialTransmitWriter
+{
+public:
+    PacketSerialTransmitWriter(QueuesType& queues, StreamType& stream, bool block, bool priority):
+        _queues(queues),
+        _stream(stream),
+        _block(block),
+        _priority(priority),
+        _overflow(false)
+    {
+    }
+
+    size_t write(uint8_t data)
+    {
+        // A high-priority frame may have to go out first, so this can take
+        // more than one byte.
+        while (_queues.full(_priority))
+        {
+            if (!_block)
+            {
+                _overflow = true;
+                return 0;
+            }
+
+            _stream.write(_queues.pop());
+        }
+
+        _queues.push(_priority, data);
+        return 1;
+    }
+
+    /// \returns false if the frame did not fit and was rolled back.
+    bool commit()
+    {
+        if (_overflow)
+        {
+            _queues.rollback(_priority);
+            return false;
+        }
+
+        _queues.commit(_priority);
+        return true;
+    }
+
+private:
+    QueuesType& _queues;
+    StreamType& _stream;
+    bool _block;
+    bool _priority;
+    bool _overflow;
+};
+
+/// \brief Without a transmit queue, frames are written straight to the
+/// serial port.
+///
+/// If the stream can write a block at once, the frame is collected in a
+/// small block and written when the block is full and on commit().
+template<uint8_t PacketMarker, typename StreamType>
+class PacketSerialTransmitWriter<PacketSerialTransmitQueues<0, 0, PacketMarker>, StreamType>
+{
+public:
+    PacketSerialTransmitWriter(PacketSerialTransmitQueues<0, 0, PacketMarker>&, StreamType& stream, bool, bool):
+        _stream(stream),
+        _blockSize(0)
+    {
+    }
+
+    size_t write(uint8_t data)
+    {
+        _write(data, WritesBlocks());
+        return 1;
+    }
+
+    bool commit()
+    {
+        _flush(WritesBlocks());
+        return true;
+    }
+
+private:
+    typedef PacketSerialBool<PacketSerialHasWriteBytes<StreamType>::value> WritesBlocks;
+
+    void _write(uint8_t data, PacketSerialBool<true>)
+    {
+        _block[_blockSize++] = data;
+
+        if (_blockSize == sizeof(_block))
+            _flush(WritesBlocks());
+    }
+
+    void _write(uint8_t data, PacketSerialBool<false>)
+    {
+        _stream.write(data);
+    }
+
+    void _flush(PacketSerialBool<true>)
+    {
+        if (_blockSize > 0)
+            _stream.write(_block, _blockSize);
+
+        _blockSize = 0;
+    }
+
+    void _flush(PacketSerialBool<false>)
+    {
+    }
+
+    StreamType& _stream;
+    uint8_t _block[PacketSerialHasWriteBytes<StreamType>::value ? 32 : 1];
+    size_t _blockSize;
+};
+
+/// \brief The handler stored by PacketSerial_ for a `HandlerType`.
+template<typename HandlerType>
+struct PacketSerialHandler
+{
+    typedef HandlerType type;
+
+    enum { value = true };
+};
+
+template<>
+struct PacketSerialHandler<void>
+{
+    /// \brief An empty placeholder when the function pointers are used.
+    struct type
+    {
+    };
+
+    enum { value = false };
+};
+
+/// \brief When the bytes of a received frame reached update().
+///
+/// Both times are PacketSerialMicros() readings. They are taken as
+/// update() reads the bytes, so they lag the wire by up to one update()
+/// period plus the time the bytes wait in the UART driver.
+struct PacketSerialTimestamp
+{
+    /// \brief When the first byte of the frame was read.
+    uint32_t firstByteMicros;
+
+    /// \brief When the packet marker ending the frame was read.
+    uint32_t markerMicros;
+};
+
+/// \brief Detect whether a `HandlerType` takes the frame timestamps.
+///
+/// A handler that can be called as
+/// `handler(buffer, size, const PacketSerialTimestamp&)` is passed the
+/// timestamps of each frame. Other handlers are called as
+/// `handler(buffer, size)`, and no timestamps are taken.
+template<typename HandlerType>
+class PacketSerialHasTimestampHandler
+{
+    template<typename T> static char test(char (*)[sizeof((((T*)0)->operator()((const uint8_t*)0, (size_t)0, *(const PacketSerialTimestamp*)0), 0))]);
+    template<typename T> static long test(...);
+
+public:
+    enum { value = sizeof(test<HandlerType>(0)) == sizeof(char) };
+};
+
+template<>
+class PacketSerialHasTimestampHandler<void>
+{
+public:
+    enum { value = false };
+};
+
+/// \brief The decoded frames PacketSerial_ holds for poll().
+template<size_t Slots, size_t SlotSize>
+class PacketSerialReceiveQueue
+{
+public:
+    PacketSerialReceiveQueue():
+        _head(0),
+        _size(0)
+    {
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    /// \brief Copy a frame into the next free slot.
+    /// \returns false if every slot is taken.
+    bool push(const uint8_t* buffer, size_t size)
+    {
+        if (_size == Slots)
+            return false;
+
+        size_t tail = _head + _size;
+
+        if (tail >= Slots)
+            tail -= Slots;
+
+        memcpy(_slots[tail], buffer, size);
+        _sizes[tail] = size;
+        _size++;
+
+        return true;
+    }
+
+    /// \returns the oldest frame, or nullptr if there is none.
+    const uint8_t* front(size_t& size) const
+    {
+        if (_size == 0)
+        {
+            size = 0;
+            return nullptr;
+        }
+
+        size = _sizes[_head];
+        return _slots[_head];
+    }
+
+    /// \brief Free the oldest slot.
+    void pop()
+    {
+        if (_size == 0)
+            return;
+
+        if (++_head == Slots)
+            _head = 0;
+
+        _size--;
+    }
+
+private:
+    uint8_t _slots[Slots][SlotSize];
+    size_t _sizes[Slots];
+    size_t _head;
+    size_t _size;
+};
+
+/// \brief The empty receive queue of a PacketSerial_ without slots.
+template<size_t SlotSize>
+class PacketSerialReceiveQueue<0, SlotSize>
+{
+public:
+    size_t size() const
+    {
+        return 0;
+    }
+
+    const uint8_t* front(size_t& size) const
+    {
+        size = 0;
+        return nullptr;
+    }
+
+    void pop()
+    {
+    }
+};
+
+/// \brief The bytes update() read in one `readBytes()` call and has not
+/// handled yet.
+template<bool ReadsBytes>
+struct PacketSerialReadBlock
+{
+    uint8_t data[32];
+    size_t index = 0;
+    size_t size = 0;
+};
+
+/// \brief No read block for a stream read one `read()` at a time, such as
+/// the MWX `Serial`.
+template<>
+struct PacketSerialReadBlock<false>
+{
+};
+
+/// \brief A snapshot of a link's statistics, sent as one telemetry packet.
+///
+/// Like the `DeviceData` structs it starts with an `id` byte, so it can
+/// share a link with sensor packets. The fields are in the sender's byte
+/// order, which is big-endian on the JN516x.
+struct PacketSerialStatsPacket
+{
+    uint8_t id;
+    uint8_t reserved[3];
+    uint32_t framesReceived;     ///< Frames handled or stored for poll().
+    uint32_t bytesReceived;      ///< Decoded payload bytes in those frames.
+    uint32_t framesSent;         ///< Frames written or queued by send().
+    uint32_t bytesSent;          ///< Payload bytes in those frames.
+    uint32_t decodeErrors;       ///< See decodeErrorCount().
+    uint32_t checksumErrors;     ///< See checksumErrorCount().
+    uint32_t overflows;          ///< Frames that overflowed the receive buffer.
+    uint32_t transmitDrops;      ///< See transmitDropCount().
+    uint32_t receiveDrops;       ///< See receiveDropCount().
+    uint32_t maxFrameSize;       ///< Largest frame received or sent.
+    uint32_t updateMicros;       ///< Total time spent in update().
+    uint32_t maxUpdateMicros;    ///< Longest update() call.
+    uint32_t sendMicros;         ///< Total time spent in send().
+    uint32_t maxSendMicros;      ///< Longest send() call.
+    uint32_t frameGapMicros;     ///< Time between the last two received frames.
+    uint32_t maxFrameGapMicros;  ///< Longest time between received frames.
+};
+
+/// \brief The default statistics policy: nothing is counted or timed.
+///
+/// Every hook is empty, so a PacketSerial_ without statistics compiles to
+/// the same code as before, and never reads the clock.
+class PacketSerialNoStats
+{
+public:
+    enum { Enabled = 0 };
+
+    uint32_t start() const
+    {
+        return 0;
+    }
+
+    void updated(uint32_t)
+    {
+    }
+
+    void sent(uint32_t, size_t, bool)
+    {
+    }
+
+    void received(size_t)
+    {
+    }
+
+    void overflowed()
+    {
+    }
+};
+
+/// \brief Counts frames and bytes and times update() and send().
+///
+/// Each hook costs a few additions, plus one PacketSerialMicros() call per
+/// update(), send() and received frame, so it can be left on in flight
+/// builds. Times are in microseconds; the totals wrap after about 71
+/// minutes of time spent in the call, so compare two snapshots rather than
+/// reading one.
+class PacketSerialStats
+{
+public:
+    enum { Enabled = 1 };
+
+    /// \returns the time a timed call started.
+    uint32_t start() const
+    {
+        return PacketSerialMicros();
+    }
+
+    /// \brief Add an update() call that started at \p start.
+    void updated(uint32_t start)
+    {
+        _time(start, updateMicros, maxUpdateMicros);
+    }
+
+    /// \brief Add a send() call that started at \p start.
+    void sent(uint32_t start, size_t size, bool ok)
+    {
+        _time(start, sendMicros, maxSendMicros);
+
+        if (!ok)
+            return;
+
+        framesSent++;
+        bytesSent += size;
+        _maxSize(size);
+    }
+
+    /// \brief Add a frame passed to the handler or stored for poll().
+    ///
+    /// Frames dropped for want of a receive slot are not added.
+    void received(size_t size)
+    {
+        uint32_t now = PacketSerialMicros();
+
+        if (framesReceived > 0)
+        {
+            frameGapMicros = now - _lastFrameMicros;
+
+            if (frameGapMicros > maxFrameGapMicros)
+                maxFrameGapMicros = frameGapMicros;
+        }
+
+        _lastFrameMicros = now;
+        framesReceived++;
+        bytesReceived += size;
+        _maxSize(size);
+    }
+
+    /// \brief Add a frame that overflowed the receive buffer.
+    void overflowed()
+    {
+        overflows++;
+    }
+
+    uint32_t framesReceived = 0;
+    uint32_t bytesReceived = 0;
+    uint32_t framesSent = 0;
+    uint32_t bytesSent = 0;
+    uint32_t overflows = 0;
+    uint32_t maxFrameSize = 0;
+    uint32_t updateMicros = 0;
+    uint32_t maxUpdateMicros = 0;
+    uint32_t sendMicros = 0;
+    uint32_t maxSendMicros = 0;
+    uint32_t frameGapMicros = 0;
+    uint32_t maxFrameGapMicros = 0;
+
+private:
+    void _time(uint32_t start, uint32_t& total, uint32_t& longest)
+    {
+        uint32_t elapsed = PacketSerialMicros() - start;
+        total += elapsed;
+
+        if (elapsed > longest)
+            longest = elapsed;
+    }
+
+    void _maxSize(size_t size)
+    {
+        if (size > maxFrameSize)
+            maxFrameSize = size;
+    }
+
+    uint32_t _lastFrameMicros = 0;
+};
+
+/// \brief The default link options of PacketSerial_.
+///
+/// The options a PacketSerial_ is rarely built without come first in its
+/// template parameters. The rest are members of an options struct, so a
+/// link only names the ones it changes. Derive from this struct and
+/// redefine those:
+///
+///     struct TelemetryOptions: PacketSerialDefaultOptions
+///     {
+///         enum { TransmitBufferSize = 512, PriorityBufferSize = 64 };
+///         typedef PacketSerialStats StatsType;
+///     };
+///
+///     PacketSerial_<COBS, 0, 256, false, NoFrameCheck, TelemetryOptions> link;
+///
+/// See PacketSerial_ for what each option does.
+struct PacketSerialDefaultOptions
+{
+    enum
+    {
+        /// \brief The number of bytes in the transmit queue.
+        TransmitBufferSize = 0,
+
+        /// \brief The number of bytes in the high-priority transmit queue.
+        PriorityBufferSize = 0,
+
+        /// \brief The number of decoded frames update() can hold for poll().
+        ReceiveSlots = 0
+    };
+
+    /// \brief The functor called for each received frame, or void.
+    typedef void HandlerType;
+
+    /// \brief The type of the serial port.
+    typedef PacketSerialDefaultStream StreamType;
+
+    /// \brief The link statistics.
+    typedef PacketSerialNoStats StatsType;
+};
+
+/// \brief PacketSerialDefaultOptions with a `HandlerType` and a
+/// `StreamType`, the options most often changed together.
+///
+///     PacketSerial_<COBS, 0, 256, false, NoFrameCheck, PacketSerialOptions<Router, TTYStream> > link(stream);
+///
+/// \tparam Handler The `HandlerType`, or void.
+/// \tparam Stream The `StreamType`.
+template<typename Handler, typename Stream = PacketSerialDefaultStream>
+struct PacketSerialOptions: PacketSerialDefaultOptions
+{
+    typedef Handler HandlerType;
+    typedef Stream StreamType;
+};
+
+/// \brief A template class enabling packet-based Serial communication.
+///
+/// Typically one of the typedefined versions are used, for example,
+/// `COBSPacketSerial` or `SLIPPacketSerial`.
+///
+/// The template parameters allow the user to define their own packet encoder /
+/// decoder, custom packet marker and receive buffer size.
+///
+/// \tparam EncoderType The static packet encoder class name.
+/// \tparam PacketMarker The byte value used to mark the packet boundary.
+/// \tparam BufferSize The number of bytes allocated for the receive buffer.
+/// \tparam DecodeInPlace If true, buffered frames are decoded inside the
+///         receive buffer with `EncoderType::decodeInPlace()` instead of into
+///         a temporary stack array. Stream-decoded frames (COBS, SLIP) are
+///         always handed to the packet handler from the receive buffer. While
+///         the handler runs on a frame in the receive buffer, an update()
+///         it calls itself only sends: the bytes after the frame are read
+///         once the handler returns, so the frame stays intact without a
+///         copy.
+/// \tparam FrameCheckType A frame check appended to every packet, such as
+///         CRC16FrameCheck. Received frames that fail the check are dropped
+///         in update() and counted by checksumErrorCount(). The default
+///         NoFrameCheck adds nothing. Encoders without a StreamEncoder
+///         (COBS/R, COBS/ZPE) gather each packet and its check value in a
+///         member buffer of `ReceiveBufferSize` bytes first, so send()
+///         returns false for packets that do not fit in it.
+/// \tparam OptionsType The remaining options, as members of a struct
+///         derived from PacketSerialDefaultOptions:
+///         - `TransmitBufferSize`: the number of bytes in the transmit queue.
+///           If 0, send() writes to the serial port before it returns.
+///           Otherwise send() encodes into the queue and update() passes the
+///           queued bytes to the serial port a burst at a time.
+///         - `PriorityBufferSize`: the number of bytes in a second transmit
+///           queue for frames sent with HIGH_PRIORITY. Needs a
+///           `TransmitBufferSize`. Once the frame being sent is finished, a
+///           waiting high-priority frame goes out before any queued normal
+///           frame.
+///         - `ReceiveSlots`: the number of decoded frames update() can hold
+///           for poll(). If 0, frames are passed to the packet handler
+///           inside update() instead.
+///         - `HandlerType`: a functor type, called as `handler(buffer, size)`
+///           for each received frame. It is stored in the PacketSerial_ and
+///           called directly, so the call can be inlined. If void (the
+///           default), the function pointers given to setPacketHandler() are
+///           called instead. A handler that also takes a
+///           PacketSerialTimestamp is called with the frame timestamps.
+///         - `StreamType`: the type of the serial port, or of any object
+///           with `available()`, `read()` and `write(uint8_t)`. By default
+///           the type of `Serial` / `Serial1`. Each instance has its own
+///           stream, so several links can run side by side, e.g. one per
+///           UART.
+///         - `StatsType`: PacketSerialStats to count frames and time update()
+///           and send(), see stats() and sendStats(). The default
+///           PacketSerialNoStats compiles the counters out.
+template<typename EncoderType, uint8_t PacketMarker = 0, size_t ReceiveBufferSize = 256, bool DecodeInPlace = false, typename FrameCheckType = NoFrameCheck, typename OptionsType = PacketSerialDefaultOptions>
+class PacketSerial_
+{
+public:
+    enum
+    {
+        /// \brief See PacketSerialDefaultOptions.
+        TransmitBufferSize = OptionsType::TransmitBufferSize,
+
+        /// \brief See PacketSerialDefaultOptions.
+        PriorityBufferSize = OptionsType::PriorityBufferSize,
+
+        /// \brief See PacketSerialDefaultOptions.
+        ReceiveSlots = OptionsType::ReceiveSlots
+    };
+
+    /// \brief See PacketSerialDefaultOptions.
+    typedef typename OptionsType::HandlerType HandlerType;
+
+    /// \brief See PacketSerialDefaultOptions.
+    typedef typename OptionsType::StreamType StreamType;
+
+    /// \brief See PacketSerialDefaultOptions.
+    typedef typename OptionsType::StatsType StatsType;
+
+    /// \brief A typedef describing the packet handler method.
+    ///
+    /// The packet handler method usually has the form:
+    ///
+    ///     void onPacketReceived(const uint8_t* buffer, size_t size);
+    ///
+    /// where buffer is a pointer to the incoming buffer array, and size is the
+    /// number of bytes in the incoming buffer.
+    typedef void (*PacketHandlerFunction)(const uint8_t* buffer, size_t size);
+
+    /// \brief A typedef describing the packet handler method.
+    ///
+    /// The packet handler method usually has the form:
+    ///
+    ///     void onPacketReceived(void* sender, const uint8_t* buffer, size_t size);
+    ///
+    /// where sender is a pointer to the PacketSerial_ instance that recieved
+    /// the buffer,  buffer is a pointer to the incoming buffer array, and size
+    /// is the number of bytes in the incoming buffer.
+    typedef void (*PacketHandlerFunctionWithSender)(const void* sender, const uint8_t* buffer, size_t size);
+
+    /// \brief A typedef describing the timestamped packet handler method.
+    ///
+    /// The packet handler method usually has the form:
+    ///
+    ///     void onPacketReceived(const uint8_t* buffer, size_t size, const PacketSerialTimestamp& timestamp);
+    ///
+    /// where timestamp holds the times the first byte and the packet marker
+    /// of the frame were read.
+    typedef void (*PacketHandlerFunctionWithTimestamp)(const uint8_t* buffer, size_t size, const PacketSerialTimestamp& timestamp);
+
+    /// \brief What send() does when a packet does not fit in the transmit
+    /// queue.
+    enum TransmitPolicy
+    {
+        /// \brief Write queued bytes to the serial port until it fits.
+        BLOCK_WHEN_FULL,
+
+        /// \brief Drop the packet and count it in transmitDropCount().
+        DROP_WHEN_FULL
+    };
+
+    /// \brief The transmit queue a packet is sent through.
+    enum TransmitPriority
+    {
+        /// \brief The normal queue, in order.
+        NORMAL_PRIORITY,
+
+        /// \brief The high-priority queue, ahead of every normal packet
+        /// that has not started yet. Needs a `PriorityBufferSize`.
+        HIGH_PRIORITY
+    };
+
+    /// \brief The stored handler: `HandlerType`, or an empty placeholder.
+    typedef typename PacketSerialHandler<HandlerType>::type Handler;
+
+    /// \brief Get the stored `HandlerType` handler, e.g. to update its state.
+    Handler& handler()
+    {
+        return _handler;
+    }
+
+    /// \brief Construct a default PacketSerial_ device.
+    ///
+    /// The default stream is used, see PacketSerialDefaultStream. With
+    /// another `StreamType`, call setStream() before use.
+    PacketSerial_():
+        _receiveBufferIndex(0),
+        _onPacketFunction(nullptr),
+        _onPacketFunctionWithSender(nullptr),
+        _senderPtr(nullptr),
+        _stream(PacketSerialStream<StreamType>::defaultStream())
+    {
+    }
+
+    /// \brief Construct a PacketSerial_ device on the given stream.
+    ///
+    ///     COBSPacketSerial pcLink(Serial);
+    ///     COBSPacketSerial servoLink(Serial1);
+    ///
+    /// \param stream The stream to read and write packets on.
+    explicit PacketSerial_(StreamType& stream):
+        _receiveBufferIndex(0),
+        _onPacketFunction(nullptr),
+        _onPacketFunctionWithSender(nullptr),
+        _senderPtr(nullptr),
+        _stream(&stream)
+    {
+    }
+
+    /// \brief Construct a PacketSerial_ device on the given stream with a
+    /// `HandlerType` handler.
+    /// \param stream The stream to read and write packets on.
+    /// \param handler The handler to copy.
+    PacketSerial_(StreamType& stream, const Handler& handler):
+        _receiveBufferIndex(0),
+        _onPacketFunction(nullptr),
+        _onPacketFunctionWithSender(nullptr),
+        _senderPtr(nullptr),
+        _stream(&stream),
+        _handler(handler)
+    {
+    }
+
+    /// \brief Construct a PacketSerial_ device with a `HandlerType` handler.
+    ///
+    /// Needed for handlers that cannot be default constructed, such as
+    /// lambdas:
+    ///
+    ///     auto onPacket = [](const uint8_t* buffer, size_t size) { ... };
+    ///
+    ///     PacketSerial_<COBS, 0, 256, false, NoFrameCheck, PacketSerialOptions<decltype(onPacket)> > myPacketSerial(onPacket);
+    ///
+    /// \param handler The handler to copy.
+    explicit PacketSerial_(const Handler& handler):
+        _receiveBufferIndex(0),
+        _onPacketFunction(nullptr),
+        _onPacketFunctionWithSender(nullptr),
+        _senderPtr(nullptr),
+        _stream(PacketSerialStream<StreamType>::defaultStream()),
+        _handler(handler)
+    {
+    }
+
+    /// \brief Destroy the PacketSerial_ device.
+    ~PacketSerial_()
+    {
+    }
+
+    /// \brief Begin a default serial connection with the given speed.
+    ///
+    /// The PacketSerial_'s stream (by default `Serial` or `Serial1`) and
+    /// default config `SERIAL_8N1` will be used. For example:
+    ///
+    ///     PacketSerial myPacketSerial;
+    ///
+    ///     void setup()
+    ///     {
+    ///         myPacketSerial1.begin(9600);
+    ///     }
+    ///
+    /// This is a convenience method. For more complex Serial port
+    /// configurations, use the `setStream()` function to set an arbitrary
+    /// Arduino Stream.
+    ///
+    /// \param speed The serial data transmission speed in bits / second (baud).
+    /// \sa https://www.arduino.cc/en/Serial/Begin
+    void begin(unsigned long speed)
+    {
+        _stream->begin(speed);
+    }
+
+    /// \brief Set the stream to read and write packets on.
+    ///
+    /// The stream must already be set up, e.g. with `Serial1.begin()`.
+    ///
+    /// \param stream A pointer to the stream.
+    void setStream(StreamType* stream)
+    {
+        _stream = stream;
+    }
+
+    /// \returns a pointer to the stream.
+    StreamType* getStream() const
+    {
+        return _stream;
+    }
+
+    /// \brief The update function services the serial connection.
+    ///
+    /// This must be called often, ideally once per `loop()`, e.g.:
+    ///
+    ///     void loop()
+    ///     {
+    ///         // Other program code.
+    ///
+    ///         myPacketSerial1.update();
+    ///     }
+    ///
+    /// If the stream has `readBytes()`, received bytes are read a block at a
+    /// time, and each block is searched for the packet marker with
+    /// `memchr()`, so the bytes between markers are handled as one span.
+    /// Otherwise `available()` is called once per batch of bytes.
+    ///
+    /// With a transmit queue, update() also passes up to one burst of queued
+    /// bytes to the serial port (see setTransmitBurstSize()). With receive
+    /// slots, decoded frames are stored for poll() instead of being passed
+    /// to the packet handler.
+    void update()
+    {
+        uint32_t start = _stats.start();
+
+        _drain(_transmitBurstSize);
+        _updateDropRate(PacketSerialBool<(ReceiveSlots > 0)>());
+
+        // Called from a handler still reading _receiveBuffer: receive later.
+        if (!_dispatching)
+            _receive(PacketSerialBool<PacketSerialHasReadBytes<StreamType>::value>());
+
+        _stats.updated(start);
+    }
+
+    /// \brief Set a packet of data.
+    ///
+    /// This function will encode and send an arbitrary packet of data. After
+    /// sending, it will send the specified `PacketMarker` defined in the
+    /// template parameters.
+    ///
+    /// Encoders with a `StreamEncoder` (COBS, SLIP) write each encoded byte
+    /// straight to the serial port, so stack use does not grow with the
+    /// packet size. Other encoders encode into a stack buffer first.
+    ///
+    /// With a `FrameCheckType`, the check value is computed in the same pass
+    /// as the encode and sent after the data.
+    ///
+    /// With a `TransmitBufferSize`, the encoded packet is queued and send()
+    /// returns without waiting for the serial port. If the queue is full, the
+    /// TransmitPolicy decides whether send() waits or drops the packet.
+    ///
+    ///     // Make an array.
+    ///     uint8_t myPacket[2] = { 255, 10 };
+    ///
+    ///     // Send the array.
+    ///     myPacketSerial1.send(myPacket, 2);
+    ///
+    /// \param buffer A pointer to a data buffer.
+    /// \param size The number of bytes in the data buffer.
+    /// \returns false if the packet was empty or dropped.
+    bool send(const uint8_t* buffer, size_t size)
+    {
+        if(buffer == nullptr || size == 0) return false;
+
+        uint32_t start = _stats.start();
+        bool sent = _send(buffer, size, StreamEncoding());
+        _stats.sent(start, size, sent);
+
+        return sent;
+    }
+
+    /// \brief Send a packet through a const PacketSerial_.
+    ///
+    /// send() used to be `void send(...) const`. Callers that ignored the
+    /// result still compile against the bool version, and this overload
+    /// keeps code that sends through a const reference compiling too. It is
+    /// only available on links whose send() changes no member: no transmit
+    /// queue, no statistics, and no gather buffer for a frame check (see
+    /// `FrameCheckType`).
+    ///
+    /// \param buffer A pointer to a data buffer.
+    /// \param size The number of bytes in the data buffer.
+    /// \returns false if the packet was empty.
+    bool send(const uint8_t* buffer, size_t size) const
+    {
+        static_assert(TransmitBufferSize == 0, "send() on a const PacketSerial_ needs TransmitBufferSize 0");
+        static_assert(!StatsType::Enabled, "send() on a const PacketSerial_ needs PacketSerialNoStats");
+        static_assert(FrameCheckType::Size == 0 || PacketSerialHasStreamEncoder<EncoderType>::value,
+                      "send() on a const PacketSerial_ needs a StreamEncoder when a frame check is used");
+
+        return const_cast<PacketSerial_*>(this)->send(buffer, size);
+    }
+
+    /// \brief Send a fixed-size packet, such as a `DeviceData` struct.
+    ///
+    /// The packet size is a compile-time constant, so any encode buffer is
+    /// a fixed-size array rather than a variable-length one. Packets whose
+    /// encoded size would not fit in the receive buffer, pointers and types
+    /// that are not trivially copyable are rejected at compile time.
+    ///
+    ///     DeviceData::PitotData data;
+    ///     myPacketSerial1.send(data);
+    ///
+    /// The `EncoderType` must provide a `constexpr getEncodedBufferSize()`.
+    ///
+    /// \param packet The packet to send.
+    template<typename T>
+    bool send(const T& packet)
+    {
+        static_assert(!PacketSerialIsPointer<T>::value, "send(const T&) sends the pointer itself; use send(buffer, size)");
+        static_assert(PacketSerialIsTriviallyCopyable<T>::value, "send(const T&) needs a trivially copyable type");
+        static_assert(EncoderType::getEncodedBufferSize(sizeof(T) + FrameCheckType::Size) < ReceiveBufferSize,
+                      "the encoded packet does not fit in the receive buffer");
+
+        uint32_t start = _stats.start();
+        bool sent = _sendFixed<sizeof(T)>(reinterpret_cast<const uint8_t*>(&packet),
+                                          PacketSerialBool<PacketSerialHasStreamEncoder<EncoderType>::value || FrameCheckType::Size != 0>());
+        _stats.sent(start, sizeof(T), sent);
+
+        return sent;
+    }
+
+    /// \brief Send a packet that is scattered over several buffers.
+    ///
+    /// The fragments are encoded as one packet, in order, without first
+    /// being copied into a single buffer. Without a frame check, the
+    /// `EncoderType` must provide an `encode()` overload taking fragments, as
+    /// COBS and SLIP do.
+    ///
+    ///     PacketFragment fragments[2] = {
+    ///         { header, sizeof(header) },
+    ///         { (const uint8_t*)&imuData, sizeof(imuData) }
+    ///     };
+    ///
+    ///     myPacketSerial1.send(fragments, 2);
+    ///
+    /// \param fragments A pointer to the array of fragments.
+    /// \param count The number of fragments in the array.
+    bool send(const PacketFragment* fragments, size_t count)
+    {
+        if(fragments == nullptr) return false;
+
+        size_t size = PacketFragment::totalSize(fragments, count);
+
+        if(size == 0) return false;
+
+        uint32_t start = _stats.start();
+        bool sent = _send(fragments, count, StreamEncoding());
+        _stats.sent(start, size, sent);
+
+        return sent;
+    }
+
+    /// \brief Send a header and a payload as one packet.
+    ///
+    /// A convenience for the common two-fragment case.
+    ///
+    ///     myPacketSerial1.send(header, sizeof(header),
+    ///                          (const uint8_t*)&imuData, sizeof(imuData));
+    ///
+    /// \param header A pointer to the header bytes.
+    /// \param headerSize The number of bytes in the \p header.
+    /// \param payload A pointer to the payload bytes.
+    /// \param payloadSize The number of bytes in the \p payload.
+    bool send(const uint8_t* header,
+              size_t headerSize,
+              const uint8_t* payload,
+              size_t payloadSize)
+    {
+        PacketFragment fragments[2] = {
+            { header, headerSize },
+            { payload, payloadSize }
+        };
+
+        return send(fragments, 2);
+    }
+
+    /// \brief Send a packet through the given transmit queue.
+    ///
+    /// Control packets, such as servo commands, can be sent with
+    /// HIGH_PRIORITY so that queued telemetry does not hold them up:
+    ///
+    ///     struct ControlOptions: PacketSerialDefaultOptions
+    ///     {
+    ///         enum { TransmitBufferSize = 512, PriorityBufferSize = 64 };
+    ///     };
+    ///
+    ///     PacketSerial_<COBS, 0, 256, false, NoFrameCheck, ControlOptions> link;
+    ///
+    ///     link.send(imuData);
+    ///     link.send(servoData, link.HIGH_PRIORITY);
+    ///
+    /// A high-priority packet still waits for the packet already being
+    /// passed to the serial port, and for the bytes already handed to the
+    /// UART driver (at most one setTransmitBurstSize() burst per update()).
+    ///
+    /// \param buffer A pointer to a data buffer.
+    /// \param size The number of bytes in the data buffer.
+    /// \param priority The transmit queue to use.
+    /// \returns false if the packet was empty or dropped.
+    bool send(const uint8_t* buffer, size_t size, TransmitPriority priority)
+    {
+        static_assert(PriorityBufferSize > 0, "HIGH_PRIORITY needs a PriorityBufferSize");
+
+        _transmitPriority = priority;
+        bool sent = send(buffer, size);
+        _transmitPriority = NORMAL_PRIORITY;
+
+        return sent;
+    }
+
+    /// \brief Send a fixed-size packet through the given transmit queue.
+    /// \param packet The packet to send.
+    /// \param priority The transmit queue to use.
+    template<typename T>
+    bool send(const T& packet, TransmitPriority priority)
+    {
+        static_assert(PriorityBufferSize > 0, "HIGH_PRIORITY needs a PriorityBufferSize");
+
+        _transmitPriority = priority;
+        bool sent = send(packet);
+        _transmitPriority = NORMAL_PRIORITY;
+
+        return sent;
+    }
+
+    /// \brief Send a scattered packet through the given transmit queue.
+    /// \param fragments A pointer to the array of fragments.
+    /// \param count The number of fragments in the array.
+    /// \param priority The transmit queue to use.
+    bool send(const PacketFragment* fragments, size_t count, TransmitPriority priority)
+    {
+        static_assert(PriorityBufferSize > 0, "HIGH_PRIORITY needs a PriorityBufferSize");
+
+        _transmitPriority = priority;
+        bool sent = send(fragments, count);
+        _transmitPriority = NORMAL_PRIORITY;
+
+        return sent;
+    }
+
+    /// \brief Set the function that will receive decoded packets.
+    ///
+    /// This function will be called when data is read from the serial stream
+    /// connection and a packet is decoded. The decoded packet will be passed
+    /// to the packet handler. The packet handler must have the form:
+    ///
+    /// The packet handler method usually has the form:
+    ///
+    ///     void onPacketReceived(const uint8_t* buffer, size_t size);
+    ///
+    /// The packet handler would then be registered like this:
+    ///
+    ///     myPacketSerial1.setPacketHandler(&onPacketReceived);
+    ///
+    /// Setting a packet handler will remove all other packet handlers.
+    ///
+    /// \param onPacketFunction A pointer to the packet handler function.
+    void setPacketHandler(PacketHandlerFunction onPacketFunction)
+    {
+        static_assert(!TypedHandler::value, "this PacketSerial_ calls its HandlerType instead");
+
+        _onPacketFunction = onPacketFunction;
+        _onPacketFunctionWithSender = nullptr;
+        _onPacketFunctionWithTimestamp = nullptr;
+        _senderPtr = nullptr;
+    }
+
+    /// \brief Set the function that will receive decoded packets.
+    ///
+    /// This function will be called when data is read from the serial stream
+    /// connection and a packet is decoded. The decoded packet will be passed
+    /// to the packet handler. The packet handler must have the form:
+    ///
+    /// The packet handler method usually has the form:
+    ///
+    ///     void onPacketReceived(const void* sender, const uint8_t* buffer, size_t size);
+    ///
+    /// To determine the sender, compare the pointer to the known possible
+    /// PacketSerial senders.
+    ///
+    ///     void onPacketReceived(void* sender, const uint8_t* buffer, size_t size)
+    ///     {
+    ///         if (sender == &myPacketSerial)
+    ///         {
+    ///             // Do something with the packet from myPacketSerial1.
+    ///         }
+    ///         else if (sender == &myOtherPacketSerial)
+    ///         {
+    ///             // Do something with the packet from myOtherPacketSerial1.
+    ///         }
+    ///     }
+    ///
+    /// The packet handler would then be registered like this:
+    ///
+    ///     myPacketSerial1.setPacketHandler(&onPacketReceived);
+    ///
+    /// You can also register an arbitrary void* pointer to be passed to your packet handler method.
+    /// This is most useful when PacketSerial is used inside a class, to pass a pointer to
+    /// the containing class:
+    ///
+    ///     class EchoClass {
+    ///       public:
+    ///         void begin(unsigned long speed) {
+    ///           myPacketSerial1.setPacketHandler(&onPacketReceived, this);
+    ///           myPacketSerial1.begin(speed);
+    ///         }
+    ///     
+    ///         // C-style callbacks can't use non-static methods,
+    ///         // so we use a static method that receives "this" as the sender argument:
+    ///         // https://wiki.c2.com/?VirtualStaticIdiom
+    ///         static void onPacketReceived(const void* sender, const uint8_t* buffer, size_t size) {
+    ///           ((EchoClass*)sender)->onPacketReceived(buffer, size);
+    ///         }
+    ///     
+    ///         void onPacketReceived(const uint8_t* buffer, size_t size) {
+    ///             // we can now use myPacketSerial as needed here
+    ///         }
+    ///     
+    ///         PacketSerial myPacketSerial;
+    ///     };
+    ///
+    /// Setting a packet handler will remove all other packet handlers.
+    ///
+    /// \param onPacketFunctionWithSender A pointer to the packet handler function.
+    /// \param senderPtr Optional pointer to a void* pointer, default argument will pass a pointer to the sending PacketSerial instance to the callback
+    void setPacketHandler(PacketHandlerFunctionWithSender onPacketFunctionWithSender, void * senderPtr = nullptr)
+    {
+        static_assert(!TypedHandler::value, "this PacketSerial_ calls its HandlerType instead");
+
+        _onPacketFunction = nullptr;
+        _onPacketFunctionWithSender = onPacketFunctionWithSender;
+        _onPacketFunctionWithTimestamp = nullptr;
+        _senderPtr = senderPtr;
+        // for backwards compatibility, the default _senderPtr is "this", but you can't use "this" as a default argument
+        if(!senderPtr) _senderPtr = this;
+    }
+
+    /// \brief Set the function that will receive decoded packets and the
+    /// times they arrived.
+    ///
+    /// The packet handler must have the form:
+    ///
+    ///     void onPacketReceived(const uint8_t* buffer, size_t size, const PacketSerialTimestamp& timestamp)
+    ///     {
+    ///         uint32_t transferMicros = timestamp.markerMicros - timestamp.firstByteMicros;
+    ///     }
+    ///
+    /// The timestamps are only taken while such a handler is set, or when
+    /// the `HandlerType` accepts them.
+    ///
+    /// Setting a packet handler will remove all other packet handlers.
+    ///
+    /// \param onPacketFunctionWithTimestamp A pointer to the packet handler
+    ///        function.
+    void setPacketHandler(PacketHandlerFunctionWithTimestamp onPacketFunctionWithTimestamp)
+    {
+        static_assert(!TypedHandler::value, "this PacketSerial_ calls its HandlerType instead");
+
+        _onPacketFunction = nullptr;
+        _onPacketFunctionWithSender = nullptr;
+        _onPacketFunctionWithTimestamp = onPacketFunctionWithTimestamp;
+        _senderPtr = nullptr;
+    }
+
+    /// \brief Check to see if the receive buffer overflowed.
+    ///
+    /// This must be called often, directly after the `update()` function.
+    ///
+    ///     void loop()
+    ///     {
+    ///         // Other program code.
+    ///         myPacketSerial1.update();
+    ///
+    ///         // Check for a receive buffer overflow.
+    ///         if (myPacketSerial1.overflow())
+    ///         {
+    ///             // Send an alert via a pin (e.g. make an overflow LED) or return a
+    ///             // user-defined packet to the sender.
+    ///             //
+    ///             // Ultimately you may need to just increase your recieve buffer via the
+    ///             // template parameters.
+    ///         }
+    ///     }
+    ///
+    /// The state is reset every time a new packet marker is received NOT when 
+    /// overflow() method is called.
+    ///
+    /// \returns true if the receive buffer overflowed.
+    bool overflow() const
+    {
+        return _recieveBufferOverflow;
+    }
+
+    /// \brief Get the number of malformed frames received.
+    ///
+    /// A frame is malformed if the stream decoder rejects it (for example a
+    /// SLIP ESC byte followed by anything but ESC_END or ESC_ESC, or a COBS
+    /// frame that ends part way through a block), or if a buffered
+    /// `EncoderType::decode()` returns 0 for a non-empty frame. Malformed
+    /// frames are still passed to the packet handler, with a size of 0,
+    /// unless a `FrameCheckType` is used, in which case they are dropped.
+    ///
+    /// \returns the number of malformed frames since construction.
+    size_t decodeErrorCount() const
+    {
+        return _decodeErrorCount;
+    }
+
+    /// \brief Get the number of frames dropped by the frame check.
+    ///
+    /// A frame is dropped if it is too short to hold the check value or if
+    /// the check value does not match, e.g. after line noise or a receive
+    /// buffer overflow. Dropped frames never reach the packet handler. Empty
+    /// frames, such as the leading SLIP END, are ignored without counting.
+    ///
+    /// \returns the number of dropped frames since construction. Always 0
+    ///          with the default NoFrameCheck.
+    size_t checksumErrorCount() const
+    {
+        return _checksumErrorCount;
+    }
+
+    /// \brief Choose what send() does when the transmit queue is full.
+    ///
+    /// The default is BLOCK_WHEN_FULL, which behaves like an unqueued send()
+    /// once the queue fills up. DROP_WHEN_FULL never waits for the serial
+    /// port, so it suits telemetry sent from time-critical code.
+    ///
+    /// \param policy The TransmitPolicy to use.
+    void setTransmitPolicy(TransmitPolicy policy)
+    {
+        _transmitPolicy = policy;
+    }
+
+    /// \brief Set the most queued bytes update() passes to the serial port.
+    ///
+    /// Keep this below the free space of the UART driver's own buffer so that
+    /// update() never waits for the line. The default is 32 bytes.
+    ///
+    /// \param size The number of bytes per update() call.
+    void setTransmitBurstSize(size_t size)
+    {
+        _transmitBurstSize = size;
+    }
+
+    /// \brief Write every queued byte to the serial port, waiting if needed.
+    void flush()
+    {
+        _drain(_transmitQueues.size());
+    }
+
+    /// \returns the number of bytes waiting in the transmit queue.
+    size_t transmitQueueDepth() const
+    {
+        return _transmitQueues.size();
+    }
+
+    /// \returns the most bytes the transmit queue has held since construction.
+    size_t transmitHighWaterMark() const
+    {
+        return _transmitQueues.highWaterMark();
+    }
+
+    /// \returns the most bytes the high-priority transmit queue has held
+    ///          since construction.
+    size_t priorityHighWaterMark() const
+    {
+        return _transmitQueues.priorityHighWaterMark();
+    }
+
+    /// \returns the number of packets dropped by DROP_WHEN_FULL since
+    ///          construction.
+    size_t transmitDropCount() const
+    {
+        return _transmitDropCount;
+    }
+
+    /// \brief Get the oldest received frame.
+    ///
+    /// Only available with `ReceiveSlots`. The frame stays in its slot, and
+    /// poll() keeps returning it, until release() is called. update() can
+    /// run in the meantime and fill the other slots, so a slow consumer does
+    /// not hold up the UART.
+    ///
+    ///     void loop()
+    ///     {
+    ///         myPacketSerial.update();
+    ///
+    ///         size_t size;
+    ///
+    ///         while (const uint8_t* buffer = myPacketSerial.poll(size))
+    ///         {
+    ///             forwardToRadio(buffer, size);
+    ///             myPacketSerial.release();
+    ///         }
+    ///     }
+    ///
+    /// \param size Set to the number of bytes in the frame.
+    /// \returns a pointer to the frame, or nullptr if no frame is waiting.
+    const uint8_t* poll(size_t& size) const
+    {
+        static_assert(ReceiveSlots > 0, "poll() needs ReceiveSlots");
+
+        return _receiveQueue.front(size);
+    }
+
+    /// \brief Free the slot of the frame returned by poll().
+    void release()
+    {
+        static_assert(ReceiveSlots > 0, "release() needs ReceiveSlots");
+
+        _receiveQueue.pop();
+    }
+
+    /// \returns the number of frames waiting for poll().
+    size_t receiveQueueDepth() const
+    {
+        return _receiveQueue.size();
+    }
+
+    /// \brief Get the number of frames dropped because every slot was taken.
+    /// \returns the number of dropped frames since construction.
+    size_t receiveDropCount() const
+    {
+        return _receiveDropCount;
+    }
+
+    /// \brief Get the number of frames dropped in the last full second.
+    ///
+    /// The one-second window is measured with PacketSerialMillis() and rolled
+    /// over by update().
+    ///
+    /// \returns the number of frames dropped in the last window.
+    size_t receiveDropsPerSecond() const
+    {
+        return _receiveDropsPerSecond;
+    }
+
+    /// \brief Get the link statistics.
+    ///
+    /// Only counted with `StatsType` PacketSerialStats:
+    ///
+    ///     struct StatsOptions: PacketSerialDefaultOptions
+    ///     {
+    ///         typedef PacketSerialStats StatsType;
+    ///     };
+    ///
+    ///     PacketSerial_<COBS, 0, 256, false, NoFrameCheck, StatsOptions> myPacketSerial;
+    ///
+    /// \returns the `StatsType` counters.
+    const StatsType& stats() const
+    {
+        return _stats;
+    }
+
+    /// \brief Fill a telemetry packet with the current statistics.
+    /// \param id The id byte of the packet.
+    /// \returns the statistics, together with the error and drop counters.
+    PacketSerialStatsPacket statsPacket(uint8_t id) const
+    {
+        static_assert(StatsType::Enabled, "statsPacket() needs StatsType PacketSerialStats");
+
+        PacketSerialStatsPacket packet;
+        memset(&packet, 0, sizeof(packet));
+
+        packet.id = id;
+        packet.framesReceived = _stats.framesReceived;
+        packet.bytesReceived = _stats.bytesReceived;
+        packet.framesSent = _stats.framesSent;
+        packet.bytesSent = _stats.bytesSent;
+        packet.decodeErrors = _decodeErrorCount;
+        packet.checksumErrors = _checksumErrorCount;
+        packet.overflows = _stats.overflows;
+        packet.transmitDrops = _transmitDropCount;
+        packet.receiveDrops = _receiveDropCount;
+        packet.maxFrameSize = _stats.maxFrameSize;
+        packet.updateMicros = _stats.updateMicros;
+        packet.maxUpdateMicros = _stats.maxUpdateMicros;
+        packet.sendMicros = _stats.sendMicros;
+        packet.maxSendMicros = _stats.maxSendMicros;
+        packet.frameGapMicros = _stats.frameGapMicros;
+        packet.maxFrameGapMicros = _stats.maxFrameGapMicros;
+
+        return packet;
+    }
+
+    /// \brief Send the current statistics over this link as one packet.
+    ///
+    /// The packet is a PacketSerialStatsPacket. It is counted like any
+    /// other send(), from the next snapshot on.
+    ///
+    /// \param id The id byte of the packet, to tell it apart from the other
+    ///        packets on the link.
+    /// \returns false if the packet was dropped.
+    bool sendStats(uint8_t id)
+    {
+        PacketSerialStatsPacket packet = statsPacket(id);
+        return send(packet);
+    }
+
+private:
+    PacketSerial_(const PacketSerial_&);
+    PacketSerial_& operator = (const PacketSerial_&);
+
+    typedef PacketSerialBool<PacketSerialHasStreamDecoder<EncoderType>::value> Streaming;
+
+    typedef PacketSerialBool<PacketSerialHasStreamEncoder<EncoderType>::value> StreamEncoding;
+
+    typedef PacketSerialBool<FrameCheckType::Size != 0> Checked;
+
+    typedef PacketSerialHandler<HandlerType> TypedHandler;
+
+    typedef PacketSerialHasTimestampHandler<HandlerType> TimestampHandler;
+
+    typedef PacketSerialTransmitQueues<TransmitBufferSize, PriorityBufferSize, PacketMarker> TransmitQueues;
+
+    typedef PacketSerialTransmitWriter<TransmitQueues, StreamType> TransmitWriter;
+
+    static_assert(PriorityBufferSize == 0 || TransmitBufferSize > 0, "a PriorityBufferSize needs a TransmitBufferSize");
+
+    /// \brief Encode into a stack buffer, then write it to the serial port.
+    bool _send(const uint8_t* buffer, size_t size, PacketSerialBool<false>)
+    {
+        return _sendBuffered(buffer, size, Checked());
+    }
+
+    /// \brief Encode into a stack buffer, then write it to the serial port.
+    bool _send(const PacketFragment* fragments, size_t count, PacketSerialBool<false>)
+    {
+        return _sendBuffered(fragments, count, Checked());
+    }
+
+    /// \brief Encode a packet without a check value into a stack buffer.
+    bool _sendBuffered(const uint8_t* buffer, size_t size, PacketSerialBool<false>)
+    {
+        return _encodeAndWrite(buffer, size);
+    }
+
+    /// \brief Encode a packet without a check value into a stack buffer.
+    bool _sendBuffered(const PacketFragment* fragments, size_t count, PacketSerialBool<false>)
+    {
+        return _encodeAndWrite(fragments, count);
+    }
+
+    /// \brief Append the check value to a packet, then encode it.
+    bool _sendBuffered(const uint8_t* buffer, size_t size, PacketSerialBool<true>)
+    {
+        PacketFragment fragment = { buffer, size };
+        return _sendBuffered(&fragment, 1, PacketSerialBool<true>());
+    }
+
+    /// \brief Gather the packet and its check value, then encode it.
+    ///
+    /// Buffered encoders only take one contiguous buffer, so the check value
+    /// is computed while the fragments are copied together into
+    /// _packetBuffer. That leaves the encode buffer as the only array on the
+    /// stack, as on the unchecked path.
+    bool _sendBuffered(const PacketFragment* fragments, size_t count, PacketSerialBool<true>)
+    {
+        size_t size = PacketFragment::totalSize(fragments, count);
+
+        if (size > sizeof(_packetBuffer) - FrameCheckType::Size)
+            return false;
+
+        FrameCheckType frameCheck;
+
+        size_t write_index = 0;
+
+        for (size_t fragment = 0; fragment < count; fragment++)
+        {
+            for (size_t read_index = 0; read_index < fragments[fragment].size; read_index++)
+            {
+                uint8_t data = fragments[fragment].buffer[read_index];
+                frameCheck.update(data);
+                _packetBuffer[write_index++] = data;
+            }
+        }
+
+        frameCheck.get(_packetBuffer + size);
+
+        return _encodeAndWrite(_packetBuffer, size + FrameCheckType::Size);
+    }
+
+    /// \brief Encode a contiguous packet and write it to the serial port.
+    bool _encodeAndWrite(const uint8_t* buffer, size_t size)
+    {
+        uint8_t _encodeBuffer[EncoderType::getEncodedBufferSize(size)];
+
+        size_t numEncoded = EncoderType::encode(buffer,
+                                                size,
+                                                _encodeBuffer);
+
+        return _write(_encodeBuffer, numEncoded);
+    }
+
+    /// \brief Encode a scattered packet and write it to the serial port.
+    bool _encodeAndWrite(const PacketFragment* fragments, size_t count)
+    {
+        uint8_t _encodeBuffer[EncoderType::getEncodedBufferSize(PacketFragment::totalSize(fragments, count))];
+
+        size_t numEncoded = EncoderType::encode(fragments,
+                                                count,
+                                                _encodeBuffer);
+
+        return _write(_encodeBuffer, numEncoded);
+    }
+
+    /// \brief Encode straight to the serial port.
+    ///
+    /// The check value, if any, is computed by the encoder as it reads each
+    /// byte.
+    template<typename SourceType>
+    bool _send(SourceType source, size_t size, PacketSerialBool<true>)
+    {
+        TransmitWriter writer(_transmitQueues, *_stream, _transmitPolicy == BLOCK_WHEN_FULL, _transmitPriority == HIGH_PRIORITY);
+        FrameCheckType frameCheck;
+
+        EncoderType::StreamEncoder::encode(source, size, writer, frameCheck);
+        writer.write(PacketMarker);
+
+        return _commit(writer);
+    }
+
+    /// \brief Encode a fixed-size packet into a fixed-size stack buffer.
+    template<size_t Size>
+    bool _sendFixed(const uint8_t* buffer, PacketSerialBool<false>)
+    {
+        uint8_t _encodeBuffer[EncoderType::getEncodedBufferSize(Size)];
+
+        size_t numEncoded = EncoderType::encode(buffer,
+                                                Size,
+                                                _encodeBuffer);
+
+        return _write(_encodeBuffer, numEncoded);
+    }
+
+    /// \brief Send a fixed-size packet through the regular send path.
+    ///
+    /// Used when the encoder writes straight to the serial port or a check
+    /// value has to be appended.
+    template<size_t Size>
+    bool _sendFixed(const uint8_t* buffer, PacketSerialBool<true>)
+    {
+        return _send(buffer, Size, StreamEncoding());
+    }
+
+    /// \brief Write an encoded packet followed by the packet marker.
+    bool _write(const uint8_t* buffer, size_t size)
+    {
+        TransmitWriter writer(_transmitQueues, *_stream, _transmitPolicy == BLOCK_WHEN_FULL, _transmitPriority == HIGH_PRIORITY);
+
+        for(size_t i=0;i<size;i++){
+            writer.write(buffer[i]);
+        }
+        writer.write(PacketMarker);
+
+        return _commit(writer);
+    }
+
+    /// \brief Complete a queued frame, or count it as dropped.
+    bool _commit(TransmitWriter& writer)
+    {
+        if (writer.commit())
+            return true;
+
+        _transmitDropCount++;
+        return false;
+    }
+
+    /// \brief Roll the one-second receive drop window over.
+    void _updateDropRate(PacketSerialBool<true>)
+    {
+        uint32_t now = PacketSerialMillis();
+
+        if ((uint32_t)(now - _receiveDropWindowStart) >= 1000)
+        {
+            _receiveDropsPerSecond = _receiveDropsThisSecond;
+            _receiveDropsThisSecond = 0;
+            _receiveDropWindowStart = now;
+        }
+    }
+
+    void _updateDropRate(PacketSerialBool<false>)
+    {
+    }
+
+    /// \brief Pass queued bytes to the UART driver, at most one burst.
+    void _drain(size_t burst)
+    {
+        _drain(burst, PacketSerialBool<PacketSerialHasWriteBytes<StreamType>::value && (TransmitBufferSize > 0)>());
+    }
+
+    /// \brief Write the burst a block at a time.
+    void _drain(size_t burst, PacketSerialBool<true>)
+    {
+        uint8_t block[32];
+
+        while (burst > 0 && _transmitQueues.size() > 0)
+        {
+            size_t size = 0;
+
+            while (size < sizeof(block) && size < burst && _transmitQueues.size() > 0)
+                block[size++] = _transmitQueues.pop();
+
+            _stream->write(block, size);
+            burst -= size;
+        }
+    }
+
+    void _drain(size_t burst, PacketSerialBool<false>)
+    {
+        while (burst > 0 && _transmitQueues.size() > 0)
+        {
+            _stream->write(_transmitQueues.pop());
+            burst--;
+        }
+    }
+
+    /// \brief Read a block at a time and handle the spans between markers.
+    void _receive(PacketSerialBool<true>)
+    {
+        for (;;)
+        {
+            if (_readBlock.index == _readBlock.size && !_fillReadBlock())
+                break;
+
+            const uint8_t* data = _readBlock.data + _readBlock.index;
+            size_t size = _readBlock.size - _readBlock.index;
+            const uint8_t* marker = static_cast<const uint8_t*>(memchr(data, PacketMarker, size));
+
+            if (marker == nullptr)
+            {
+                _readBlock.index = _readBlock.size;
+                _stampFirstByte();
+                _onPacketBytes(data, size, Streaming());
+            }
+            else
+            {
+                // Consume the marker first, so that a handler calling
+                // update() carries on after it.
+                _readBlock.index += (marker - data) + 1;
+
+                if (marker != data)
+                    _stampFirstByte();
+
+                _onPacketBytes(data, marker - data, Streaming());
+                _stampMarker();
+                _onPacketMarker(Streaming());
+            }
+        }
+    }
+
+    /// \brief Read one byte at a time, asking the stream how many bytes are
+    /// ready once per batch rather than once per byte.
+    void _receive(PacketSerialBool<false>)
+    {
+        int available;
+
+        while ((available = _stream->available()) > 0)
+        {
+            while (available-- > 0)
+            {
+                uint8_t data = _stream->read();
+
+                if (data == PacketMarker)
+                {
+                    _stampMarker();
+                    _onPacketMarker(Streaming());
+                }
+                else
+                {
+                    _stampFirstByte();
+                    _onPacketBytes(&data, 1, Streaming());
+                }
+            }
+        }
+    }
+
+    /// \returns true if the frame timestamps are needed.
+    bool _timestamped() const
+    {
+        return TypedHandler::value ? (bool)TimestampHandler::value : _onPacketFunctionWithTimestamp != nullptr;
+    }
+
+    /// \brief Note when the first byte of a frame was read.
+    void _stampFirstByte()
+    {
+        if (_timestamped() && !_frameStarted)
+        {
+            _frameStarted = true;
+            _timestamp.firstByteMicros = PacketSerialMicros();
+        }
+    }
+
+    /// \brief Note when the packet marker of a frame was read.
+    void _stampMarker()
+    {
+        if (_timestamped())
+        {
+            _timestamp.markerMicros = PacketSerialMicros();
+
+            if (!_frameStarted)
+                _timestamp.firstByteMicros = _timestamp.markerMicros;
+
+            _frameStarted = false;
+        }
+    }
+
+    /// \brief Read the bytes the stream has ready into the read block.
+    /// \returns false if no bytes were ready.
+    bool _fillReadBlock()
+    {
+        int available = _stream->available();
+
+        if (available <= 0)
+            return false;
+
+        size_t size = (size_t)available < sizeof(_readBlock.data) ? (size_t)available : sizeof(_readBlock.data);
+
+        _readBlock.index = 0;
+        _readBlock.size = _stream->readBytes(_readBlock.data, size);
+
+        return _readBlock.size > 0;
+    }
+
+    /// \brief Store raw bytes, to be decoded when the marker arrives.
+    void _onPacketBytes(const uint8_t* data, size_t size, PacketSerialBool<false>)
+    {
+        // Keep one byte spare, as a full buffer counts as overflowed.
+        size_t space = ReceiveBufferSize - 1 - _receiveBufferIndex;
+
+        if (size > space)
+        {
+            // The buffer will be in an overflowed state if we write
+            // so set a buffer overflowed flag.
+            _recieveBufferOverflow = true;
+            size = space;
+        }
+
+        memcpy(_receiveBuffer + _receiveBufferIndex, data, size);
+        _receiveBufferIndex += size;
+    }
+
+    /// \brief Decode bytes as they arrive and store the decoded output.
+    ///
+    /// The frame check is updated with the decoded bytes of the whole span.
+    void _onPacketBytes(const uint8_t* data, size_t size, PacketSerialBool<true>)
+    {
+        size_t index = _receiveBufferIndex;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            // Keep one byte spare, as the buffered path does, so both
+            // overflow at the same frame size.
+            if (!_decoder.push(data[i], _receiveBuffer, _receiveBufferIndex, ReceiveBufferSize - 1))
+            {
+                _recieveBufferOverflow = true;
+            }
+        }
+
+        _frameCheck.update(_receiveBuffer + index, _receiveBufferIndex - index);
+    }
+
+    /// \brief Decode the buffered frame and pass it to the packet handler.
+    void _onPacketMarker(PacketSerialBool<false>)
+    {
+        if (_recieveBufferOverflow)
+            _stats.overflowed();
+
+        if (ReceiveSlots > 0 || TypedHandler::value || _onPacketFunction || _onPacketFunctionWithSender || _onPacketFunctionWithTimestamp)
+        {
+            _decodeAndDispatch(PacketSerialBool<DecodeInPlace>());
+        }
+        else
+        {
+            _receiveBufferIndex = 0;
+            _recieveBufferOverflow = false;
+        }
+    }
 
-    /// \brief A typedef describing the packet handler method.
-    ///
-    /// The packet handler method usually has the form:
-    ///
-    ///     void onPacketReceived(void* sender, const uint8_t* buffer, size_t size);
-    ///
-    /// where sender is a pointer to the PacketSerial_ instance that recieved
-    /// the buffer,  buffer is a pointer to the incoming buffer array, and size
-    /// is the number of bytes in the incoming buffer.
-    typedef void (*PacketHandlerFunctionWithSender)(const void* sender, const uint8_t* buffer, size_t size);
+    /// \brief Decode the buffered frame into a temporary stack array.
+    void _decodeAndDispatch(PacketSerialBool<false>)
+    {
+        uint8_t _decodeBuffer[_receiveBufferIndex];
 
-    /// \brief Construct a default PacketSerial_ device.
-    PacketSerial_():
-        _receiveBufferIndex(0),
-        _onPacketFunction(nullptr),
-        _onPacketFunctionWithSender(nullptr),
-        _senderPtr(nullptr)
+        size_t numDecoded = EncoderType::decode(_receiveBuffer,
+                                                _receiveBufferIndex,
+                                                _decodeBuffer);
+
+        bool decoded = (numDecoded > 0 || _receiveBufferIndex == 0);
+
+        if (!decoded)
+            _decodeErrorCount++;
+
+        _frameCheck.update(_decodeBuffer, numDecoded);
+
+        bool accepted = _checkFrame(numDecoded, decoded, Checked());
+
+        // clear the index here so that the callback function can call update() if needed and receive more data
+        _receiveBufferIndex = 0;
+        _recieveBufferOverflow = false;
+
+        if (accepted)
+            _dispatch(_decodeBuffer, numDecoded);
+    }
+
+    /// \brief Decode the buffered frame inside the receive buffer.
+    void _decodeAndDispatch(PacketSerialBool<true>)
     {
+        size_t numDecoded = EncoderType::decodeInPlace(_receiveBuffer,
+                                                       _receiveBufferIndex);
+
+        bool decoded = (numDecoded > 0 || _receiveBufferIndex == 0);
+
+        if (!decoded)
+            _decodeErrorCount++;
+
+        _frameCheck.update(_receiveBuffer, numDecoded);
+
+        bool accepted = _checkFrame(numDecoded, decoded, Checked());
+
+        _receiveBufferIndex = 0;
+        _recieveBufferOverflow = false;
+
+        if (accepted)
+            _dispatchReceived(numDecoded);
     }
 
-    /// \brief Destroy the PacketSerial_ device.
-    ~PacketSerial_()
+    /// \brief Pass the already decoded frame to the packet handler.
+    void _onPacketMarker(PacketSerialBool<true>)
     {
+        if (_recieveBufferOverflow)
+            _stats.overflowed();
+
+        size_t numDecoded = _receiveBufferIndex;
+        bool decoded = _decoder.finish();
+
+        if (!decoded)
+        {
+            numDecoded = 0;
+            _decodeErrorCount++;
+        }
+
+        bool accepted = _checkFrame(numDecoded, decoded, Checked());
+
+        _receiveBufferIndex = 0;
+        _recieveBufferOverflow = false;
+
+        if (accepted)
+            _dispatchReceived(numDecoded);
     }
 
-    /// \brief Begin a default serial connection with the given speed.
-    ///
-    /// The default Serial port `Serial` and default config `SERIAL_8N1` will be
-    /// used. For example:
-    ///
-    ///     PacketSerial myPacketSerial;
-    ///
-    ///     void setup()
-    ///     {
-    ///         myPacketSerial1.begin(9600);
-    ///     }
-    ///
-    /// This is a convenience method. For more complex Serial port
-    /// configurations, use the `setStream()` function to set an arbitrary
-    /// Arduino Stream.
+    /// \brief Pass a frame to the packet handler straight from
+    /// `_receiveBuffer`.
     ///
-    /// \param speed The serial data transmission speed in bits / second (baud).
-    /// \sa https://www.arduino.cc/en/Serial/Begin
-    void begin(unsigned long speed)
+    /// An update() called by the handler does not receive until the handler
+    /// returns, so nothing overwrites the frame while the handler reads it.
+    void _dispatchReceived(size_t size)
     {
-#ifdef UART0
-        Serial.begin(speed);
-#else
-        Serial1.begin(speed);
-#endif
+        _dispatching = true;
+        _dispatch(_receiveBuffer, size);
+        _dispatching = false;
     }
 
-    /// \brief The update function services the serial connection.
-    ///
-    /// This must be called often, ideally once per `loop()`, e.g.:
-    ///
-    ///     void loop()
-    ///     {
-    ///         // Other program code.
+    /// \brief Without a frame check every frame is passed on.
+    bool _checkFrame(size_t&, bool, PacketSerialBool<false>)
+    {
+        return true;
+    }
+
+    /// \brief Verify and strip the check value of a decoded frame.
     ///
-    ///         myPacketSerial1.update();
-    ///     }
+    /// The frame check has already been run over the decoded bytes.
     ///
-    void update()
+    /// \param size The decoded frame size, reduced by the check value size.
+    /// \param decoded false if the frame failed to decode.
+    /// \returns true if the frame should be passed to the packet handler.
+    bool _checkFrame(size_t& size, bool decoded, PacketSerialBool<true>)
     {
-#ifdef UART0
+        bool valid = _frameCheck.valid();
+        _frameCheck.reset();
 
-        while (Serial.available() > 0)
-        {
-            uint8_t data = Serial.read();
-#else
-        while (Serial1.available() > 0)
+        if (!decoded || size == 0)
+            return false;
+
+        if (size < (size_t)FrameCheckType::Size || !valid)
         {
-            uint8_t data = Serial1.read();
-#endif
-            if (data == PacketMarker)
-            {
-                if (_onPacketFunction || _onPacketFunctionWithSender)
-                {
-                    uint8_t _decodeBuffer[_receiveBufferIndex];
-
-                    size_t numDecoded = EncoderType::decode(_receiveBuffer,
-                                                            _receiveBufferIndex,
-                                                            _decodeBuffer);
-
-                    // clear the index here so that the callback function can call update() if needed and receive more data
-                    _receiveBufferIndex = 0;
-                    _recieveBufferOverflow = false;
-
-                    if (_onPacketFunction)
-                    {
-                        _onPacketFunction(_decodeBuffer, numDecoded);
-                    }
-                    else if (_onPacketFunctionWithSender)
-                    {
-                        _onPacketFunctionWithSender(_senderPtr, _decodeBuffer, numDecoded);
-                    }
-
-                } else {
-                    _receiveBufferIndex = 0;
-                    _recieveBufferOverflow = false;
-                }
-            }
-            else
-            {
-                if ((_receiveBufferIndex + 1) < ReceiveBufferSize)
-                {
-                    _receiveBuffer[_receiveBufferIndex++] = data;
-                }
-                else
-                {
-                    // The buffer will be in an overflowed state if we write
-                    // so set a buffer overflowed flag.
-                    _recieveBufferOverflow = true;
-                }
-            }
+            _checksumErrorCount++;
+            return false;
         }
+
+        size -= FrameCheckType::Size;
+        return true;
     }
 
-    /// \brief Set a packet of data.
-    ///
-    /// This function will encode and send an arbitrary packet of data. After
-    /// sending, it will send the specified `PacketMarker` defined in the
-    /// template parameters.
-    ///
-    ///     // Make an array.
-    ///     uint8_t myPacket[2] = { 255, 10 };
-    ///
-    ///     // Send the array.
-    ///     myPacketSerial1.send(myPacket, 2);
+    void _dispatch(const uint8_t* buffer, size_t size)
+    {
+        _dispatch(buffer, size, PacketSerialBool<(ReceiveSlots > 0)>());
+    }
+
+    /// \brief Store the frame for poll().
     ///
-    /// \param buffer A pointer to a data buffer.
-    /// \param size The number of bytes in the data buffer.
-    void send(const uint8_t* buffer, size_t size) const
+    /// Empty frames, such as the leading SLIP END or a malformed frame, are
+    /// not worth a slot.
+    void _dispatch(const uint8_t* buffer, size_t size, PacketSerialBool<true>)
     {
-        if(buffer == nullptr || size == 0) return;
+        if (size == 0)
+            return;
 
-        uint8_t _encodeBuffer[EncoderType::getEncodedBufferSize(size)];
+        // A dropped frame is counted in receiveDropCount() only, so the
+        // two totals add up to the frames decoded.
+        if (!_receiveQueue.push(buffer, size))
+        {
+            _receiveDropCount++;
+            _receiveDropsThisSecond++;
+            return;
+        }
 
-        size_t numEncoded = EncoderType::encode(buffer,
-                                                size,
-                                                _encodeBuffer);
+        _stats.received(size);
+    }
 
-#ifdef UART0
-        for(size_t i=0;i<numEncoded;i++){
-            Serial.write(_encodeBuffer[i]);
-        }
-        Serial.write(PacketMarker);
-#else
-        for(size_t i=0;i<numEncoded;i++){
-            Serial1.write(_encodeBuffer[i]);
-        }
-        Serial1.write(PacketMarker);
-#endif
+    /// \brief Call the packet handler.
+    void _dispatch(const uint8_t* buffer, size_t size, PacketSerialBool<false>)
+    {
+        if (size > 0)
+            _stats.received(size);
+
+        _callHandler(buffer, size, PacketSerialBool<TypedHandler::value>());
     }
 
-    /// \brief Set the function that will receive decoded packets.
-    ///
-    /// This function will be called when data is read from the serial stream
-    /// connection and a packet is decoded. The decoded packet will be passed
-    /// to the packet handler. The packet handler must have the form:
-    ///
-    /// The packet handler method usually has the form:
-    ///
-    ///     void onPacketReceived(const uint8_t* buffer, size_t size);
-    ///
-    /// The packet handler would then be registered like this:
-    ///
-    ///     myPacketSerial1.setPacketHandler(&onPacketReceived);
-    ///
-    /// Setting a packet handler will remove all other packet handlers.
-    ///
-    /// \param onPacketFunction A pointer to the packet handler function.
-    void setPacketHandler(PacketHandlerFunction onPacketFunction)
+    /// \brief Call the `HandlerType` handler.
+    void _callHandler(const uint8_t* buffer, size_t size, PacketSerialBool<true>)
     {
-        _onPacketFunction = onPacketFunction;
-        _onPacketFunctionWithSender = nullptr;
-        _senderPtr = nullptr;
+        _callHandler(buffer, size, PacketSerialBool<true>(), PacketSerialBool<TimestampHandler::value>());
     }
 
-    /// \brief Set the function that will receive decoded packets.
-    ///
-    /// This function will be called when data is read from the serial stream
-    /// connection and a packet is decoded. The decoded packet will be passed
-    /// to the packet handler. The packet handler must have the form:
-    ///
-    /// The packet handler method usually has the form:
-    ///
-    ///     void onPacketReceived(const void* sender, const uint8_t* buffer, size_t size);
-    ///
-    /// To determine the sender, compare the pointer to the known possible
-    /// PacketSerial senders.
-    ///
-    ///     void onPacketReceived(void* sender, const uint8_t* buffer, size_t size)
-    ///     {
-    ///         if (sender == &myPacketSerial)
-    ///         {
-    ///             // Do something with the packet from myPacketSerial1.
-    ///         }
-    ///         else if (sender == &myOtherPacketSerial)
-    ///         {
-    ///             // Do something with the packet from myOtherPacketSerial1.
-    ///         }
-    ///     }
-    ///
-    /// The packet handler would then be registered like this:
-    ///
-    ///     myPacketSerial1.setPacketHandler(&onPacketReceived);
-    ///
-    /// You can also register an arbitrary void* pointer to be passed to your packet handler method.
-    /// This is most useful when PacketSerial is used inside a class, to pass a pointer to
-    /// the containing class:
-    ///
-    ///     class EchoClass {
-    ///       public:
-    ///         void begin(unsigned long speed) {
-    ///           myPacketSerial1.setPacketHandler(&onPacketReceived, this);
-    ///           myPacketSerial1.begin(speed);
-    ///         }
-    ///     
-    ///         // C-style callbacks can't use non-static methods,
-    ///         // so we use a static method that receives "this" as the sender argument:
-    ///         // https://wiki.c2.com/?VirtualStaticIdiom
-    ///         static void onPacketReceived(const void* sender, const uint8_t* buffer, size_t size) {
-    ///           ((EchoClass*)sender)->onPacketReceived(buffer, size);
-    ///         }
-    ///     
-    ///         void onPacketReceived(const uint8_t* buffer, size_t size) {
-    ///             // we can now use myPacketSerial as needed here
-    ///         }
-    ///     
-    ///         PacketSerial myPacketSerial;
-    ///     };
-    ///
-    /// Setting a packet handler will remove all other packet handlers.
-    ///
-    /// \param onPacketFunctionWithSender A pointer to the packet handler function.
-    /// \param senderPtr Optional pointer to a void* pointer, default argument will pass a pointer to the sending PacketSerial instance to the callback
-    void setPacketHandler(PacketHandlerFunctionWithSender onPacketFunctionWithSender, void * senderPtr = nullptr)
+    /// \brief Call the `HandlerType` handler with the frame timestamps.
+    void _callHandler(const uint8_t* buffer, size_t size, PacketSerialBool<true>, PacketSerialBool<true>)
     {
-        _onPacketFunction = nullptr;
-        _onPacketFunctionWithSender = onPacketFunctionWithSender;
-        _senderPtr = senderPtr;
-        // for backwards compatibility, the default _senderPtr is "this", but you can't use "this" as a default argument
-        if(!senderPtr) _senderPtr = this;
+        // A copy, as a handler calling update() stamps the next frame.
+        PacketSerialTimestamp timestamp = _timestamp;
+        _handler(buffer, size, timestamp);
     }
 
-    /// \brief Check to see if the receive buffer overflowed.
-    ///
-    /// This must be called often, directly after the `update()` function.
-    ///
-    ///     void loop()
-    ///     {
-    ///         // Other program code.
-    ///         myPacketSerial1.update();
-    ///
-    ///         // Check for a receive buffer overflow.
-    ///         if (myPacketSerial1.overflow())
-    ///         {
-    ///             // Send an alert via a pin (e.g. make an overflow LED) or return a
-    ///             // user-defined packet to the sender.
-    ///             //
-    ///             // Ultimately you may need to just increase your recieve buffer via the
-    ///             // template parameters.
-    ///         }
-    ///     }
-    ///
-    /// The state is reset every time a new packet marker is received NOT when 
-    /// overflow() method is called.
-    ///
-    /// \returns true if the receive buffer overflowed.
-    bool overflow() const
+    void _callHandler(const uint8_t* buffer, size_t size, PacketSerialBool<true>, PacketSerialBool<false>)
     {
-        return _recieveBufferOverflow;
+        _handler(buffer, size);
     }
 
-private:
-    PacketSerial_(const PacketSerial_&);
-    PacketSerial_& operator = (const PacketSerial_&);
+    /// \brief Call the handler function pointer, if one is set.
+    void _callHandler(const uint8_t* buffer, size_t size, PacketSerialBool<false>)
+    {
+        if (_onPacketFunction)
+        {
+            _onPacketFunction(buffer, size);
+        }
+        else if (_onPacketFunctionWithSender)
+        {
+            _onPacketFunctionWithSender(_senderPtr, buffer, size);
+        }
+        else if (_onPacketFunctionWithTimestamp)
+        {
+            PacketSerialTimestamp timestamp = _timestamp;
+            _onPacketFunctionWithTimestamp(buffer, size, timestamp);
+        }
+    }
 
     bool _recieveBufferOverflow = false;
 
+    size_t _decodeErrorCount = 0;
+    size_t _checksumErrorCount = 0;
+
     uint8_t _receiveBuffer[ReceiveBufferSize];
     size_t _receiveBufferIndex = 0;
+    bool _dispatching = false;
+
+    PacketSerialTimestamp _timestamp = { 0, 0 };
+    bool _frameStarted = false;
+
+    PacketSerialReadBlock<PacketSerialHasReadBytes<StreamType>::value> _readBlock;
+
+    typename PacketSerialStreamDecoder<EncoderType>::type _decoder;
+    FrameCheckType _frameCheck;
+
+    uint8_t _packetBuffer[(FrameCheckType::Size != 0 && !PacketSerialHasStreamEncoder<EncoderType>::value) ? ReceiveBufferSize : 1];
+
+    TransmitQueues _transmitQueues;
+    TransmitPolicy _transmitPolicy = BLOCK_WHEN_FULL;
+    TransmitPriority _transmitPriority = NORMAL_PRIORITY;
+    size_t _transmitBurstSize = 32;
+    size_t _transmitDropCount = 0;
+
+    PacketSerialReceiveQueue<ReceiveSlots, ReceiveBufferSize> _receiveQueue;
+    size_t _receiveDropCount = 0;
+    size_t _receiveDropsThisSecond = 0;
+    size_t _receiveDropsPerSecond = 0;
+    uint32_t _receiveDropWindowStart = 0;
 
     PacketHandlerFunction _onPacketFunction = nullptr;
     PacketHandlerFunctionWithSender _onPacketFunctionWithSender = nullptr;
+    PacketHandlerFunctionWithTimestamp _onPacketFunctionWithTimestamp = nullptr;
     void* _senderPtr = nullptr;
+
+    StreamType* _stream;
+
+    Handler _handler;
+
+    StatsType _stats;
 };
 
 
@@ -333,5 +2428,19 @@ typedef PacketSerial_<COBS> PacketSerial;
 /// \brief A typedef for a PacketSerial type with COBS encoding.
 typedef PacketSerial_<COBS> COBSPacketSerial;
 
+/// \brief A typedef for a PacketSerial type with COBS/R encoding.
+typedef PacketSerial_<COBSR> COBSRPacketSerial;
+
+/// \brief A typedef for a PacketSerial type with COBS/ZPE encoding.
+typedef PacketSerial_<COBSZPE> COBSZPEPacketSerial;
+
 /// \brief A typedef for a PacketSerial type with SLIP encoding.
 typedef PacketSerial_<SLIP, SLIP::END> SLIPPacketSerial;
+
+/// \brief A typedef for a PacketSerial type with COBS encoding and a CRC-16
+/// on every packet.
+typedef PacketSerial_<COBS, 0, 256, false, CRC16FrameCheck> CRC16COBSPacketSerial;
+
+/// \brief A typedef for a PacketSerial type with SLIP encoding and a CRC-16
+/// on every packet.
+typedef PacketSerial_<SLIP, SLIP::END, 256, false, CRC16FrameCheck> CRC16SLIPPacketSerial;
@@ -0,0 +1,931 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// Host-side throughput benchmark for the PacketSerial encoders.
+//
+// Builds on Linux without the TWELITE SDK, straight from the encoder headers:
+//
+//     make -C .. bench [FILTER=filter]
+//
+// Every encoder is run over payloads of 1 to 1024 bytes with random,
+// sparse-zero and all-zero contents, and over the DeviceData structs from
+// SensorPacket.h. For each case it reports MB/s of payload, ns per frame and
+// the average number of overhead bytes per frame (marker included). The
+// optional filter only runs encoders whose name contains it. The roundtrip
+// sends each frame through a PacketSerial_ on an in-memory stream and reads
+// it back with update().
+//
+// Before an encoder is timed, every frame of the workload must come back
+// unchanged from decode() and from the PacketSerial_ roundtrip. The bench
+// stops with exit status 1 if one does not.
+//
+// The CRC models from crc/crc.h are run over the same workloads with each
+// CRCEngine, from the bitwise loop to slicing-by-8.
+//
+// The dispatch section compares the cost of handing a decoded frame to a
+// function pointer handler and to a HandlerType functor.
+//
+// The drain section feeds the encoded SensorPacket traffic to update() and
+// reports the CPU time per KB received. It compares the old per-byte
+// available() / read() loop with update() on a stream that only has read()
+// (one available() call per batch) and on one that also has readBytes()
+// (block reads and memchr() marker search).
+//
+// The priority section sends a servo command every 20 ms over a simulated
+// 115200 baud UART kept saturated with IMU and GPS telemetry. It reports
+// the worst and average time from send() to the command's last byte on the
+// wire, with the command queued behind the telemetry and with it sent
+// HIGH_PRIORITY.
+//
+// The aggregate section counts the wire bytes per record when small
+// DeviceData structs are sent one per frame and when a PacketAggregator
+// packs them into larger frames.
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#define PACKETSERIAL_HOST
+#include "PacketSerial/PacketSerial.h"
+#include "PacketSerial/PacketAggregator.h"
+#include "PacketSerial/Encoding/SIMD.h"
+#include "crc/crc.h"
+#include "SensorPacket.h"
+
+namespace
+{
+    /// \brief A set of frames sharing one payload profile.
+    struct Workload
+    {
+        const char* name;
+        std::vector<std::vector<uint8_t> > frames;
+        size_t bytes;
+    };
+
+    /// \brief Keeps results alive so the compiler cannot discard the work.
+    volatile uint32_t sink = 0;
+
+    /// \brief A loopback serial port: what is written can be read back.
+    class LoopbackStream
+    {
+    public:
+        LoopbackStream():
+            _readIndex(0)
+        {
+            _data.reserve(4096);
+        }
+
+        int available() const
+        {
+            return (int)(_data.size() - _readIndex);
+        }
+
+        int read()
+        {
+            int data = _data[_readIndex++];
+
+            if (_readIndex == _data.size())
+            {
+                _data.clear();
+                _readIndex = 0;
+            }
+
+            return data;
+        }
+
+        size_t write(uint8_t data)
+        {
+            _data.push_back(data);
+            return 1;
+        }
+
+    private:
+        std::vector<uint8_t> _data;
+        size_t _readIndex;
+    };
+
+    /// \brief Counts the bytes of each frame PacketSerial_ receives.
+    struct ReceivedBytes
+    {
+        size_t* bytes;
+
+        void operator()(const uint8_t*, size_t size) const
+        {
+            *bytes += size;
+        }
+    };
+
+    /// \brief Keeps a copy of the last non-empty frame PacketSerial_ receives.
+    struct ReceivedFrame
+    {
+        std::vector<uint8_t>* frame;
+
+        void operator()(const uint8_t* buffer, size_t size) const
+        {
+            if (size > 0)
+                frame->assign(buffer, buffer + size);
+        }
+    };
+
+    /// \brief The packet marker PacketSerial_ is used with for an encoder.
+    template<typename EncoderType>
+    struct Marker
+    {
+        enum { value = 0 };
+    };
+
+    template<>
+    struct Marker<SLIP>
+    {
+        enum { value = SLIP::END };
+    };
+
+    template<>
+    struct Marker<SIMDSLIP>
+    {
+        enum { value = SLIP::END };
+    };
+
+    double seconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// \brief Time one operation over a workload until at least 50 ms pass.
+    template<typename Operation>
+    void measure(const char* encoder, const char* operation, const Workload& workload, double overhead, Operation run)
+    {
+        size_t rounds = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+
+        do
+        {
+            for (size_t i = 0; i < workload.frames.size(); i++)
+            {
+                sink = sink + (uint32_t)run(workload.frames[i]);
+            }
+
+            rounds++;
+            elapsed = seconds(start);
+        }
+        while (elapsed < 0.05);
+
+        double frames = (double)rounds * workload.frames.size();
+        double bytes = (double)rounds * workload.bytes;
+
+        printf("%-10s %-10s %-16s %10.1f MB/s %10.1f ns/frame %8.2f overhead\n",
+               encoder,
+               operation,
+               workload.name,
+               bytes / elapsed / 1e6,
+               elapsed / frames * 1e9,
+               overhead / workload.frames.size());
+    }
+
+    /// \brief Stop the bench if a frame does not come back unchanged.
+    void expect(bool condition, const char* encoder, const char* operation, const Workload& workload, size_t index)
+    {
+        if (condition)
+            return;
+
+        fprintf(stderr, "%s %s: frame %zu of %s does not round-trip\n", encoder, operation, index, workload.name);
+        exit(1);
+    }
+
+    /// \brief Check decode(encode(x)) == x and the PacketSerial_ roundtrip
+    /// for every frame of a workload.
+    template<typename EncoderType>
+    void verify(const char* name, const Workload& workload, const std::vector<std::vector<uint8_t> >& encoded)
+    {
+        typedef PacketSerial_<EncoderType, Marker<EncoderType>::value, 2 * 1024 + 8, false, NoFrameCheck, PacketSerialOptions<ReceivedFrame, LoopbackStream> > Link;
+
+        LoopbackStream stream;
+        std::vector<uint8_t> received;
+        ReceivedFrame handler = { &received };
+        Link link(stream, handler);
+
+        for (size_t i = 0; i < workload.frames.size(); i++)
+        {
+            const std::vector<uint8_t>& frame = workload.frames[i];
+            // COBS/ZPE decodes to more bytes than it encodes.
+            std::vector<uint8_t> decoded(frame.size() + encoded[i].size() + 1);
+            decoded.resize(EncoderType::decode(encoded[i].data(), encoded[i].size(), decoded.data()));
+
+            expect(decoded == frame, name, "decode", workload, i);
+
+            received.clear();
+            link.send(frame.data(), frame.size());
+            link.update();
+
+            expect(received == frame, name, "roundtrip", workload, i);
+        }
+    }
+
+    template<typename EncoderType>
+    void run(const char* name, const Workload& workload)
+    {
+        std::vector<std::vector<uint8_t> > encoded(workload.frames.size());
+        double overhead = 0;
+
+        for (size_t i = 0; i < workload.frames.size(); i++)
+        {
+            const std::vector<uint8_t>& frame = workload.frames[i];
+            encoded[i].resize(EncoderType::getEncodedBufferSize(frame.size()));
+            encoded[i].resize(EncoderType::encode(frame.data(), frame.size(), encoded[i].data()));
+            overhead += (double)encoded[i].size() + 1 - (double)frame.size();
+        }
+
+        verify<EncoderType>(name, workload, encoded);
+
+        std::vector<uint8_t> scratch(2 * EncoderType::getEncodedBufferSize(1024) + 2);
+        uint8_t* buffer = scratch.data();
+
+        measure(name, "encode", workload, overhead, [&](const std::vector<uint8_t>& frame) {
+            return EncoderType::encode(frame.data(), frame.size(), buffer);
+        });
+
+        size_t index = 0;
+        measure(name, "decode", workload, overhead, [&](const std::vector<uint8_t>&) {
+            const std::vector<uint8_t>& frame = encoded[index++ % encoded.size()];
+            return EncoderType::decode(frame.data(), frame.size(), buffer);
+        });
+
+        typedef PacketSerial_<EncoderType, Marker<EncoderType>::value, 2 * 1024 + 8, false, NoFrameCheck, PacketSerialOptions<ReceivedBytes, LoopbackStream> > Link;
+
+        LoopbackStream stream;
+        size_t received = 0;
+        ReceivedBytes handler = { &received };
+        Link link(stream, handler);
+
+        measure(name, "roundtrip", workload, overhead, [&](const std::vector<uint8_t>& frame) {
+            link.send(frame.data(), frame.size());
+            link.update();
+            return received;
+        });
+    }
+
+    template<typename Model, int Engine>
+    void runCRC(const char* name, const char* engine, const Workload& workload)
+    {
+        double overhead = (double)CRC<Model>::Size * workload.frames.size();
+
+        measure(name, engine, workload, overhead, [&](const std::vector<uint8_t>& frame) {
+            return CRC<Model, Engine>::compute(frame.data(), frame.size());
+        });
+    }
+
+    template<typename Model>
+    void runAllCRC(const char* name, const char* filter, const std::vector<Workload>& workloads)
+    {
+        if (filter && !strstr(name, filter))
+            return;
+
+        for (size_t i = 0; i < workloads.size(); i++)
+        {
+            runCRC<Model, CRC_BITWISE>(name, "bitwise", workloads[i]);
+            runCRC<Model, CRC_NIBBLE>(name, "nibble", workloads[i]);
+            runCRC<Model, CRC_TABLE>(name, "table", workloads[i]);
+            runCRC<Model, CRC_SLICE8>(name, "slice8", workloads[i]);
+        }
+    }
+
+    /// \brief The handler work: just enough to keep the call.
+    void onPacket(const uint8_t* buffer, size_t size)
+    {
+        sink = sink + (uint32_t)size + buffer[0];
+    }
+
+    void onPacketWithSender(const void*, const uint8_t* buffer, size_t size)
+    {
+        onPacket(buffer, size);
+    }
+
+    struct OnPacket
+    {
+        void operator()(const uint8_t* buffer, size_t size) const
+        {
+            onPacket(buffer, size);
+        }
+    };
+
+    /// \brief The function pointer dispatch of PacketSerial_::_dispatch().
+    struct PointerDispatch
+    {
+        void (*onPacketFunction)(const uint8_t* buffer, size_t size);
+        void (*onPacketFunctionWithSender)(const void* sender, const uint8_t* buffer, size_t size);
+        void* senderPtr;
+
+        void operator()(const uint8_t* buffer, size_t size) const
+        {
+            if (onPacketFunction)
+            {
+                onPacketFunction(buffer, size);
+            }
+            else if (onPacketFunctionWithSender)
+            {
+                onPacketFunctionWithSender(senderPtr, buffer, size);
+            }
+        }
+    };
+
+    template<typename Dispatch>
+    void runDispatch(const char* name, const Dispatch& dispatch, const Workload& workload)
+    {
+        measure("dispatch", name, workload, 0, [&](const std::vector<uint8_t>& frame) {
+            dispatch(frame.data(), frame.size());
+            return 0;
+        });
+    }
+
+    void runAllDispatch(const char* filter, const std::vector<Workload>& workloads)
+    {
+        if (filter && !strstr("dispatch", filter))
+            return;
+
+        // Set at run time, as setPacketHandler() does. The volatile read
+        // keeps the compiler from turning the pointer calls into direct ones.
+        volatile bool set = true;
+        PointerDispatch pointer = { set ? &onPacket : nullptr, nullptr, nullptr };
+        PointerDispatch withSender = { nullptr, set ? &onPacketWithSender : nullptr, nullptr };
+
+        for (size_t i = 0; i < workloads.size(); i++)
+        {
+            if (workloads[i].frames[0].size() > 16 && strcmp(workloads[i].name, "SensorPacket") != 0)
+                continue;
+
+            runDispatch("pointer", pointer, workloads[i]);
+            runDispatch("sender", withSender, workloads[i]);
+            runDispatch("functor", OnPacket(), workloads[i]);
+        }
+    }
+
+    /// \brief A received-bytes source with the call cost of a UART driver.
+    class ByteStream
+    {
+    public:
+        ByteStream(const std::vector<uint8_t>& data):
+            _data(data),
+            _readIndex(0)
+        {
+        }
+
+        void rewind()
+        {
+            _readIndex = 0;
+        }
+
+        __attribute__((noinline)) int available()
+        {
+            return (int)(_data.size() - _readIndex);
+        }
+
+        __attribute__((noinline)) int read()
+        {
+            return _data[_readIndex++];
+        }
+
+        size_t write(uint8_t)
+        {
+            return 1;
+        }
+
+    protected:
+        const std::vector<uint8_t>& _data;
+        size_t _readIndex;
+    };
+
+    /// \brief A ByteStream that can also copy out a block of bytes.
+    class BlockStream : public ByteStream
+    {
+    public:
+        BlockStream(const std::vector<uint8_t>& data):
+            ByteStream(data)
+        {
+        }
+
+        __attribute__((noinline)) size_t readBytes(uint8_t* buffer, size_t size)
+        {
+            memcpy(buffer, _data.data() + _readIndex, size);
+            _readIndex += size;
+            return size;
+        }
+    };
+
+    /// \brief The update() loop from before the block drain, for reference.
+    template<typename EncoderType, uint8_t PacketMarker>
+    struct PerByteUpdate
+    {
+        typename EncoderType::StreamDecoder decoder;
+        uint8_t buffer[256];
+        size_t index;
+        size_t received;
+
+        template<typename StreamType>
+        void update(StreamType& stream)
+        {
+            while (stream.available() > 0)
+            {
+                uint8_t data = stream.read();
+
+                if (data == PacketMarker)
+                {
+                    if (decoder.finish())
+                        received += index;
+
+                    index = 0;
+                }
+                else if (!decoder.push(data, buffer, index, sizeof(buffer)))
+                {
+                    index = 0;
+                }
+            }
+        }
+    };
+
+    /// \brief Time draining \p traffic until at least 50 ms pass.
+    template<typename Drain>
+    void measureDrain(const char* encoder, const char* loop, size_t bytes, Drain drain)
+    {
+        size_t rounds = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+
+        do
+        {
+            sink = sink + (uint32_t)drain();
+            rounds++;
+            elapsed = seconds(start);
+        }
+        while (elapsed < 0.05);
+
+        double kilobytes = (double)rounds * bytes / 1024;
+
+        printf("%-10s %-10s %-16s %10.1f MB/s %10.1f ns/KB\n",
+               encoder,
+               loop,
+               "drain",
+               kilobytes * 1024 / elapsed / 1e6,
+               elapsed / kilobytes * 1e9);
+    }
+
+    template<typename EncoderType, uint8_t PacketMarker, typename StreamType>
+    void drainLink(const char* name, const char* loop, const std::vector<uint8_t>& traffic)
+    {
+        typedef PacketSerial_<EncoderType, PacketMarker, 256, false, NoFrameCheck, PacketSerialOptions<ReceivedBytes, StreamType> > Link;
+
+        StreamType stream(traffic);
+        size_t received = 0;
+        ReceivedBytes handler = { &received };
+        Link link(stream, handler);
+
+        measureDrain(name, loop, traffic.size(), [&]() {
+            stream.rewind();
+            link.update();
+            return received;
+        });
+    }
+
+    template<typename EncoderType, uint8_t PacketMarker>
+    void runDrain(const char* name, const char* filter, const Workload& workload)
+    {
+        if (filter && !strstr("drain", filter) && !strstr(name, filter))
+            return;
+
+        std::vector<uint8_t> traffic;
+
+        for (size_t i = 0; i < workload.frames.size(); i++)
+        {
+            const std::vector<uint8_t>& frame = workload.frames[i];
+            std::vector<uint8_t> encoded(EncoderType::getEncodedBufferSize(frame.size()));
+            encoded.resize(EncoderType::encode(frame.data(), frame.size(), encoded.data()));
+            traffic.insert(traffic.end(), encoded.begin(), encoded.end());
+            traffic.push_back(PacketMarker);
+        }
+
+        ByteStream stream(traffic);
+        PerByteUpdate<EncoderType, PacketMarker> reference = {};
+
+        measureDrain(name, "per-byte", traffic.size(), [&]() {
+            stream.rewind();
+            reference.update(stream);
+            return reference.received;
+        });
+
+        drainLink<EncoderType, PacketMarker, ByteStream>(name, "batched", traffic);
+        drainLink<EncoderType, PacketMarker, BlockStream>(name, "readBytes", traffic);
+    }
+
+    /// \brief A UART whose driver has a small transmit FIFO, in virtual
+    /// time.
+    ///
+    /// Written bytes wait in the FIFO and leave it at the line rate.
+    class SimulatedUART
+    {
+    public:
+        SimulatedUART(double byteMicros, size_t fifoSize):
+            _byteMicros(byteMicros),
+            _fifoSize(fifoSize),
+            _lineFree(0)
+        {
+        }
+
+        int available() const
+        {
+            return 0;
+        }
+
+        int read()
+        {
+            return -1;
+        }
+
+        size_t write(uint8_t data)
+        {
+            _fifo.push_back(data);
+            return 1;
+        }
+
+        /// \returns the free space in the driver FIFO.
+        size_t space() const
+        {
+            return _fifo.size() < _fifoSize ? _fifoSize - _fifo.size() : 0;
+        }
+
+        /// \brief Put the bytes that finished by \p now on the wire.
+        void advance(double now, LoopbackStream& wire)
+        {
+            while (!_fifo.empty())
+            {
+                double start = _lineFree > _started ? _lineFree : _started;
+
+                if (start + _byteMicros > now)
+                    break;
+
+                _lineFree = start + _byteMicros;
+                wire.write(_fifo.front());
+                _fifo.pop_front();
+            }
+
+            if (_fifo.empty())
+                _started = now;
+        }
+
+    private:
+        std::deque<uint8_t> _fifo;
+        double _byteMicros;
+        size_t _fifoSize;
+        double _lineFree;
+        double _started = 0;
+    };
+
+    /// \brief Times control frames from send() to their last byte on the wire.
+    struct ControlLatency
+    {
+        std::deque<double> sent;
+        double now = 0;
+        double worst = 0;
+        double total = 0;
+        size_t count = 0;
+    };
+
+    struct ControlFrames
+    {
+        ControlLatency* latency;
+
+        void operator()(const uint8_t* buffer, size_t size) const
+        {
+            if (size == 0 || buffer[0] != DeviceData::ServoController || latency->sent.empty())
+                return;
+
+            double elapsed = latency->now - latency->sent.front();
+            latency->sent.pop_front();
+            latency->worst = std::max(latency->worst, elapsed);
+            latency->total += elapsed;
+            latency->count++;
+        }
+    };
+
+    /// \brief The telemetry link: a transmit queue with a high-priority lane.
+    struct ControlLinkOptions: PacketSerialDefaultOptions
+    {
+        enum { TransmitBufferSize = 512, PriorityBufferSize = 64 };
+        typedef SimulatedUART StreamType;
+    };
+
+    /// \brief Send a servo command every 20 ms over a 115200 baud link kept
+    /// full of IMU and GPS telemetry, for 10 s of virtual time.
+    template<bool Priority>
+    void measureControlLatency(const char* loop)
+    {
+        typedef PacketSerial_<COBS, 0, 256, false, NoFrameCheck, ControlLinkOptions> Link;
+        typedef PacketSerial_<COBS, 0, 256, false, NoFrameCheck, PacketSerialOptions<ControlFrames, LoopbackStream> > Receiver;
+
+        const double byteMicros = 10 * 1e6 / 115200;
+        const size_t headroom = 64;
+
+        SimulatedUART uart(byteMicros, 64);
+        Link link(uart);
+        link.setTransmitPolicy(Link::DROP_WHEN_FULL);
+
+        ControlLatency latency;
+        ControlFrames handler = { &latency };
+        LoopbackStream wire;
+        Receiver receiver(wire, handler);
+
+        DeviceData::IMUData imu;
+        memset(&imu, 0x55, sizeof(imu));
+        imu.id = DeviceData::IMU;
+
+        DeviceData::GPSData gps;
+        memset(&gps, 0x55, sizeof(gps));
+        gps.id = DeviceData::GPS;
+
+        DeviceData::ServoData servo;
+        memset(&servo, 0x55, sizeof(servo));
+        servo.id = DeviceData::ServoController;
+
+        // One loop() per millisecond.
+        for (uint32_t tick = 0; tick < 10000; tick++)
+        {
+            latency.now = tick * 1000.0;
+            uart.advance(latency.now, wire);
+            receiver.update();
+
+            while (link.transmitQueueDepth() + sizeof(imu) * 2 + headroom < 512)
+            {
+                link.send(imu);
+                link.send(gps);
+            }
+
+            if (tick % 20 == 0)
+            {
+                latency.sent.push_back(latency.now);
+
+                if (Priority)
+                    link.send(servo, Link::HIGH_PRIORITY);
+                else
+                    link.send(servo);
+            }
+
+            link.setTransmitBurstSize(uart.space());
+            link.update();
+        }
+
+        printf("%-10s %-10s %-16s %10.1f ms worst %7.1f ms avg %6zu frames\n",
+               "COBS",
+               loop,
+               "control latency",
+               latency.worst / 1000,
+               latency.count ? latency.total / latency.count / 1000 : 0.0,
+               latency.count);
+    }
+
+    void runPriority(const char* filter)
+    {
+        if (filter && !strstr("priority", filter))
+            return;
+
+        measureControlLatency<false>("normal");
+        measureControlLatency<true>("priority");
+    }
+
+    /// \brief Counts the bytes written to it.
+    struct CountingStream
+    {
+        size_t bytes;
+
+        int available() const
+        {
+            return 0;
+        }
+
+        int read()
+        {
+            return -1;
+        }
+
+        size_t write(uint8_t)
+        {
+            bytes++;
+            return 1;
+        }
+    };
+
+    typedef PacketSerial_<COBS, 0, 256, false, NoFrameCheck, PacketSerialOptions<void, CountingStream> > CountingLink;
+
+    void printAggregate(const char* loop, size_t records, size_t bytes)
+    {
+        double perRecord = (double)bytes / records;
+
+        printf("%-10s %-10s %-16s %10.2f B/record %7.0f records/s at 115200\n",
+               "COBS",
+               loop,
+               "aggregate",
+               perRecord,
+               11520 / perRecord);
+    }
+
+    template<size_t Size>
+    void measureAggregate(const char* loop, const DeviceData::VaneData& vane, const DeviceData::UltraSonicData& ultraSonic)
+    {
+        CountingStream stream = { 0 };
+        CountingLink link(stream);
+        PacketAggregator<CountingLink, Size> aggregator(link, 0xFFFFFFFF);
+
+        for (int i = 0; i < 1000; i++)
+        {
+            aggregator.add(vane);
+            aggregator.add(ultraSonic);
+        }
+
+        aggregator.flush();
+        printAggregate(loop, 2000, stream.bytes);
+    }
+
+    /// \brief Wire bytes per record for small DeviceData structs, one frame
+    /// each and packed by a PacketAggregator.
+    void runAggregate(const char* filter)
+    {
+        if (filter && !strstr("aggregate", filter))
+            return;
+
+        DeviceData::VaneData vane;
+        memset(&vane, 0x55, sizeof(vane));
+        vane.id = DeviceData::Vane;
+
+        DeviceData::UltraSonicData ultraSonic;
+        memset(&ultraSonic, 0x55, sizeof(ultraSonic));
+        ultraSonic.id = DeviceData::UltraSonic;
+
+        CountingStream stream = { 0 };
+        CountingLink link(stream);
+
+        for (int i = 0; i < 1000; i++)
+        {
+            link.send(vane);
+            link.send(ultraSonic);
+        }
+
+        printAggregate("single", 2000, stream.bytes);
+
+        measureAggregate<64>("packed/64", vane, ultraSonic);
+        measureAggregate<128>("packed/128", vane, ultraSonic);
+        measureAggregate<250>("packed/250", vane, ultraSonic);
+    }
+
+    template<typename T>
+    void addStruct(Workload& workload, const T& data)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&data);
+        workload.frames.push_back(std::vector<uint8_t>(bytes, bytes + sizeof(T)));
+        workload.bytes += sizeof(T);
+    }
+
+    /// \brief Plausible DeviceData records with zeroed padding.
+    Workload sensorWorkload()
+    {
+        Workload workload = { "SensorPacket", std::vector<std::vector<uint8_t> >(), 0 };
+
+        for (uint32_t i = 0; i < 64; i++)
+        {
+            DeviceData::IMUData imu;
+            memset(&imu, 0, sizeof(imu));
+            imu.id = DeviceData::IMU;
+            imu.calib = 0xFF;
+            imu.timestamp = 100000 + i * 20;
+            for (int k = 0; k < 3; k++)
+            {
+                imu.q[k] = (short)(rand() % 32768 - 16384);
+                imu.m[k] = (short)(rand() % 800 - 400);
+                imu.a[k] = (short)(rand() % 2000 - 1000);
+                imu.g[k] = (short)(rand() % 60 - 30);
+            }
+            addStruct(workload, imu);
+
+            DeviceData::GPSData gps;
+            memset(&gps, 0, sizeof(gps));
+            gps.id = DeviceData::GPS;
+            gps.timestamp = 100000 + i * 200;
+            gps.latitude = 35.2 + i * 1e-6;
+            gps.longitude = 136.1 - i * 1e-6;
+            gps.vx = 8.0f + (rand() % 100) / 100.0f;
+            gps.vy = -1.0f + (rand() % 100) / 100.0f;
+            addStruct(workload, gps);
+
+            DeviceData::ServoData servo;
+            memset(&servo, 0, sizeof(servo));
+            servo.id = DeviceData::ServoController;
+            servo.timestamp = 100000 + i * 20;
+            servo.rudder = (rand() % 1000) / 100.0f - 5.0f;
+            servo.elevator = (rand() % 600) / 100.0f - 3.0f;
+            servo.voltage = 7.4f;
+            addStruct(workload, servo);
+
+            DeviceData::VaneData vane;
+            memset(&vane, 0, sizeof(vane));
+            vane.id = DeviceData::Vane;
+            vane.timestamp = 100000 + i * 50;
+            vane.angle = (rand() % 3600) / 10.0f;
+            addStruct(workload, vane);
+        }
+
+        return workload;
+    }
+
+    /// \brief 64 frames of one size.
+    ///
+    /// With a negative zeroPercent the bytes are uniformly random; otherwise
+    /// zeroPercent of them are zero and the rest are non-zero.
+    Workload syntheticWorkload(const char* name, size_t size, int zeroPercent)
+    {
+        Workload workload = { name, std::vector<std::vector<uint8_t> >(), 0 };
+
+        for (int i = 0; i < 64; i++)
+        {
+            std::vector<uint8_t> frame(size);
+
+            for (size_t j = 0; j < size; j++)
+            {
+                if (zeroPercent < 0)
+                    frame[j] = (uint8_t)rand();
+                else
+                    frame[j] = (rand() % 100 < zeroPercent) ? 0 : (uint8_t)(rand() % 255 + 1);
+            }
+
+            workload.frames.push_back(frame);
+            workload.bytes += size;
+        }
+
+        return workload;
+    }
+
+    template<typename EncoderType>
+    void runAll(const char* name, const char* filter, const std::vector<Workload>& workloads)
+    {
+        if (filter && !strstr(name, filter))
+            return;
+
+        for (size_t i = 0; i < workloads.size(); i++)
+        {
+            run<EncoderType>(name, workloads[i]);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = (argc > 1) ? argv[1] : nullptr;
+
+    srand(1);
+
+    static const size_t sizes[] = { 1, 4, 16, 64, 256, 1024 };
+    static char names[3 * sizeof(sizes) / sizeof(sizes[0])][32];
+
+    std::vector<Workload> workloads;
+    size_t n = 0;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        snprintf(names[n], sizeof(names[n]), "random/%zu", sizes[i]);
+        workloads.push_back(syntheticWorkload(names[n++], sizes[i], -1));
+        snprintf(names[n], sizeof(names[n]), "sparse/%zu", sizes[i]);
+        workloads.push_back(syntheticWorkload(names[n++], sizes[i], 10));
+        snprintf(names[n], sizeof(names[n]), "zero/%zu", sizes[i]);
+        workloads.push_back(syntheticWorkload(names[n++], sizes[i], 100));
+    }
+
+    workloads.push_back(sensorWorkload());
+
+    printf("SIMD kernel: %s\n", SIMD::kernelName());
+
+    runAll<COBS>("COBS", filter, workloads);
+    runAll<WordwiseCOBS>("COBS/word", filter, workloads);
+    runAll<SIMDCOBS>("COBS/simd", filter, workloads);
+    runAll<COBSR>("COBSR", filter, workloads);
+    runAll<COBSZPE>("COBSZPE", filter, workloads);
+    runAll<SLIP>("SLIP", filter, workloads);
+    runAll<SIMDSLIP>("SLIP/simd", filter, workloads);
+
+    runAllCRC<CRC8Sensirion>("CRC8", filter, workloads);
+    runAllCRC<CRC16CCITT>("CRC16", filter, workloads);
+    runAllCRC<CRC32IEEE>("CRC32", filter, workloads);
+
+    runAllDispatch(filter, workloads);
+
+    runDrain<COBS, 0>("COBS", filter, workloads.back());
+    runDrain<SLIP, SLIP::END>("SLIP", filter, workloads.back());
+
+    runPriority(filter);
+
+    runAggregate(filter);
+
+    return 0;
+}
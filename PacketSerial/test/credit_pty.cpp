@@ -0,0 +1,296 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// Credit flow control over a pty, with a consumer that keeps stalling.
+//
+//     make -C .. check
+//
+// A forked child plays the master board: it sends numbered frames through
+// a PacketCreditSender as fast as its credits and hold buffer allow, and
+// must never have to drop one. Its link queues frames and passes them to
+// the pty a burst per update(), paced at roughly serial speed, so frames
+// are still in flight when grants arrive, as on a real UART. The
+// parent plays the gateway: update() drains the pty into an application
+// queue at full speed, but the consumer of that queue is slower than the
+// sender and stops for a while every few hundred frames. The queue must never hold more frames than the
+// credit window, every frame must arrive once and in order, and the link
+// must see no decode errors or overflows.
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#define PACKETSERIAL_HOST
+#include "PacketSerial/PacketSerial.h"
+#include "PacketSerial/PacketCredit.h"
+#include "PacketSerial/tools/TTYStream.h"
+
+namespace
+{
+    enum
+    {
+        /// \brief The frames the child sends.
+        Frames = 1000,
+
+        /// \brief The size of each frame: a type byte, a sequence number
+        /// and filler.
+        FrameSize = 32,
+
+        /// \brief The credit window, in frames.
+        Window = 16,
+
+        /// \brief The sender's hold buffer, for 8 frames.
+        HoldSize = 8 * (FrameSize + 1),
+
+        /// \brief The consumer takes a frame at most this often, slower
+        /// than the sender...
+        ConsumeMillis = 2,
+
+        /// \brief ...and stalls after this many frames...
+        StallEvery = 200,
+
+        /// \brief ...for this long.
+        StallMillis = 200,
+
+        /// \brief Both sides give up after this long.
+        TimeoutMillis = 20000
+    };
+
+    uint32_t millis()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    }
+
+    void waitReadable(int fd, int timeoutMillis)
+    {
+        pollfd readable = { fd, POLLIN, 0 };
+        poll(&readable, 1, timeoutMillis);
+    }
+
+    /// \brief The master board's link: a transmit queue on the pty.
+    struct SenderOptions: PacketSerialDefaultOptions
+    {
+        enum { TransmitBufferSize = 1024 };
+        typedef TTYStream StreamType;
+    };
+
+    /// \brief The master board: send Frames numbered frames on credit.
+    struct Sender
+    {
+        typedef PacketSerial_<COBS, 0, 256, false, NoFrameCheck, SenderOptions> Link;
+
+        static PacketCreditSender<Link, HoldSize>* credit;
+
+        static void onPacket(const uint8_t* buffer, size_t size)
+        {
+            credit->receive(buffer, size);
+        }
+
+        static int run(const char* path)
+        {
+            TTYStream tty;
+
+            if (!tty.open(path, 0))
+                return 1;
+
+            Link link(tty);
+            PacketCreditSender<Link, HoldSize> sender(link);
+            credit = &sender;
+            link.setPacketHandler(&onPacket);
+            link.setTransmitBurstSize(16);
+
+            uint32_t start = millis();
+            uint32_t sequence = 0;
+
+            while (sequence < Frames || sender.holdSize() > 0 || link.transmitQueueDepth() > 0)
+            {
+                if (millis() - start > TimeoutMillis)
+                    return 2;
+
+                link.update();
+                sender.update();
+
+                // A new frame once there is room to hold it, as a sensor
+                // loop would sample only when it can keep the result.
+                if (sequence < Frames && sender.holdSize() + 1 + FrameSize <= HoldSize)
+                {
+                    uint8_t frame[FrameSize];
+                    memset(frame, 0x55, sizeof(frame));
+                    frame[0] = 0x01;
+                    frame[1] = (uint8_t)(sequence >> 24);
+                    frame[2] = (uint8_t)(sequence >> 16);
+                    frame[3] = (uint8_t)(sequence >> 8);
+                    frame[4] = (uint8_t)sequence;
+
+                    sender.send(frame, sizeof(frame), sender.HOLD_WHEN_OUT);
+                    sequence++;
+                }
+
+                // 16 bytes a millisecond, about 160 kbaud.
+                waitReadable(tty.fd(), 1);
+            }
+
+            return sender.dropCount() == 0 ? 0 : 3;
+        }
+    };
+
+    PacketCreditSender<Sender::Link, HoldSize>* Sender::credit = nullptr;
+
+    struct Gateway;
+
+    /// \brief The receiving link's HandlerType: queues each frame.
+    struct QueueFrame
+    {
+        Gateway* gateway;
+
+        void operator()(const uint8_t* buffer, size_t size) const;
+    };
+
+    /// \brief The gateway: a link, its credit receiver and the queue of
+    /// frames waiting for the consumer.
+    struct Gateway
+    {
+        typedef PacketSerial_<COBS, 0, 256, false, NoFrameCheck, PacketSerialOptions<QueueFrame, TTYStream> > Link;
+
+        PacketCreditReceiver<Link>* credit;
+        std::deque<std::vector<uint8_t> > queue;
+        size_t maxQueue;
+
+        void onFrame(const uint8_t* buffer, size_t size)
+        {
+            credit->received();
+            queue.push_back(std::vector<uint8_t>(buffer, buffer + size));
+            maxQueue = std::max(maxQueue, queue.size());
+        }
+    };
+
+    void QueueFrame::operator()(const uint8_t* buffer, size_t size) const
+    {
+        gateway->onFrame(buffer, size);
+    }
+
+    int failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "FAIL %s\n", what);
+            failures++;
+        }
+    }
+}
+
+int main()
+{
+    int master;
+    int slave;
+    char name[64];
+
+    if (openpty(&master, &slave, name, nullptr, nullptr) != 0)
+    {
+        perror("openpty");
+        return 1;
+    }
+
+    // Raw before the child opens it, so the first grant is not echoed.
+    termios tty;
+    tcgetattr(slave, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(slave, TCSANOW, &tty);
+
+    pid_t child = fork();
+
+    if (child == 0)
+    {
+        close(master);
+        _exit(Sender::run(name));
+    }
+
+    TTYStream stream;
+    stream.attach(master);
+
+    Gateway gateway;
+    gateway.maxQueue = 0;
+
+    QueueFrame handler = { &gateway };
+    Gateway::Link link(stream, handler);
+    PacketCreditReceiver<Gateway::Link> credit(link, Window, 5, 1);
+    gateway.credit = &credit;
+
+    uint32_t start = millis();
+    uint32_t stallUntil = 0;
+    uint32_t expected = 0;
+    size_t stalls = 0;
+    bool inOrder = true;
+
+    while (expected < Frames && millis() - start < TimeoutMillis)
+    {
+        waitReadable(stream.fd(), 1);
+        link.update();
+
+        if ((int32_t)(millis() - stallUntil) >= 0 && !gateway.queue.empty())
+        {
+            const std::vector<uint8_t>& frame = gateway.queue.front();
+            uint32_t sequence = (frame.size() == FrameSize)
+                ? (uint32_t)frame[1] << 24 | (uint32_t)frame[2] << 16 | (uint32_t)frame[3] << 8 | frame[4]
+                : ~0u;
+
+            inOrder = inOrder && sequence == expected;
+            gateway.queue.pop_front();
+            credit.consumed();
+            expected++;
+
+            if (expected % StallEvery == 0)
+            {
+                stallUntil = millis() + StallMillis;
+                stalls++;
+            }
+            else
+            {
+                stallUntil = millis() + ConsumeMillis;
+            }
+        }
+
+        credit.update();
+    }
+
+    int status = -1;
+
+    if (expected < Frames)
+        kill(child, SIGTERM);
+
+    waitpid(child, &status, 0);
+    close(slave);
+
+    check(expected == Frames, "every frame arrived");
+    check(inOrder, "frames arrived once and in order");
+    check(gateway.maxQueue <= Window, "the queue never held more than the credit window");
+    check(gateway.maxQueue >= Window / 2, "the stalls backed the queue up");
+    check(link.decodeErrorCount() == 0, "no decode errors");
+    check(!link.overflow(), "no receive buffer overflow");
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "the sender finished without drops");
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "credit_pty: %d checks failed (%u frames, queue up to %zu)\n", failures, expected, gateway.maxQueue);
+        return 1;
+    }
+
+    printf("credit_pty: %u frames, %zu stalls, queue up to %zu of %d\n", expected, stalls, gateway.maxQueue, (int)Window);
+    return 0;
+}
@@ -0,0 +1,197 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// A packet handler may call update() itself, as the original PacketSerial
+// documents, without losing the frame it is reading.
+//
+//     make -C .. check
+//
+// The first frame's handler calls update() and then checks that its own
+// frame is unchanged. A buffered decoder (COBS/R) hands over a decoded copy,
+// so the nested update() delivers the frames queued behind it. Frames handed
+// over from the receive buffer (COBS, SLIP, COBS/R in place) are not copied:
+// the nested update() must not receive, and the outer one delivers the rest
+// once the handler returns. A frame whose decoded size reaches the receive
+// buffer size must overflow on both decode paths alike.
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define PACKETSERIAL_HOST
+#include "PacketSerial/PacketSerial.h"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "FAIL %s\n", what);
+            failures++;
+        }
+    }
+
+    /// \brief Bytes written to it can be read back.
+    class MemoryStream
+    {
+    public:
+        MemoryStream():
+            _readIndex(0)
+        {
+        }
+
+        int available() const
+        {
+            return (int)(_data.size() - _readIndex);
+        }
+
+        int read()
+        {
+            return _readIndex < _data.size() ? _data[_readIndex++] : -1;
+        }
+
+        size_t write(uint8_t data)
+        {
+            _data.push_back(data);
+            return 1;
+        }
+
+    private:
+        std::vector<uint8_t> _data;
+        size_t _readIndex;
+    };
+
+    /// \brief The frames each test sends, and what the handler saw.
+    struct Frames
+    {
+        uint8_t sent[3][40];
+        size_t received;
+        size_t nested;
+        bool intact;
+    };
+
+    template<typename Link>
+    struct Reentrant
+    {
+        static Link* link;
+        static Frames* frames;
+
+        static void onPacket(const uint8_t* buffer, size_t size)
+        {
+            // SLIP frames start with END too, which delivers an empty frame.
+            if (size == 0)
+                return;
+
+            size_t index = frames->received++;
+
+            if (size != sizeof(frames->sent[index]) || memcmp(buffer, frames->sent[index], size) != 0)
+                frames->intact = false;
+
+            if (index == 0)
+            {
+                link->update();
+                frames->nested = frames->received - 1;
+
+                // The later frames must not have overwritten this one.
+                if (memcmp(buffer, frames->sent[0], size) != 0)
+                    frames->intact = false;
+            }
+        }
+
+        static void run(const char* name, size_t nested)
+        {
+            MemoryStream stream;
+            Link sender(stream);
+            Link receiver(stream);
+            Frames state = {};
+
+            link = &receiver;
+            frames = &state;
+            state.intact = true;
+            receiver.setPacketHandler(&onPacket);
+
+            for (int i = 0; i < 3; i++)
+            {
+                for (size_t j = 0; j < sizeof(state.sent[i]); j++)
+                    state.sent[i][j] = (uint8_t)(i * 64 + j % 5);
+
+                sender.send(state.sent[i], sizeof(state.sent[i]));
+            }
+
+            receiver.update();
+
+            char what[128];
+            snprintf(what, sizeof(what), "%s: all frames delivered", name);
+            check(state.received == 3, what);
+            snprintf(what, sizeof(what), "%s: update() in the handler delivered %zu frames", name, nested);
+            check(state.nested == nested, what);
+            snprintf(what, sizeof(what), "%s: frames intact", name);
+            check(state.intact, what);
+        }
+    };
+
+    template<typename Link>
+    Link* Reentrant<Link>::link = nullptr;
+
+    template<typename Link>
+    Frames* Reentrant<Link>::frames = nullptr;
+
+    /// \brief Send frames of \p size bytes and report whether they arrive.
+    template<typename EncoderType, uint8_t PacketMarker>
+    bool fits(size_t size)
+    {
+        typedef PacketSerial_<EncoderType, PacketMarker, 64, false, NoFrameCheck, PacketSerialOptions<void, MemoryStream> > Link;
+
+        static size_t received;
+        struct Handler
+        {
+            static void onPacket(const uint8_t*, size_t size)
+            {
+                if (size > 0)
+                    received = size;
+            }
+        };
+
+        MemoryStream stream;
+        Link link(stream);
+        link.setPacketHandler(&Handler::onPacket);
+
+        std::vector<uint8_t> frame(size, 0x55);
+        received = 0;
+        link.send(frame.data(), frame.size());
+        link.update();
+
+        return received == size && !link.overflow();
+    }
+}
+
+int main()
+{
+    Reentrant<PacketSerial_<COBS, 0, 256, false, NoFrameCheck, PacketSerialOptions<void, MemoryStream> > >::run("COBS", 0);
+    Reentrant<PacketSerial_<SLIP, SLIP::END, 256, false, NoFrameCheck, PacketSerialOptions<void, MemoryStream> > >::run("SLIP", 0);
+    Reentrant<PacketSerial_<COBSR, 0, 256, false, NoFrameCheck, PacketSerialOptions<void, MemoryStream> > >::run("COBSR", 2);
+    Reentrant<PacketSerial_<COBSR, 0, 256, true, NoFrameCheck, PacketSerialOptions<void, MemoryStream> > >::run("COBSR in place", 0);
+    Reentrant<PacketSerial_<COBS, 0, 256, false, CRC16FrameCheck, PacketSerialOptions<void, MemoryStream> > >::run("COBS + CRC16", 0);
+
+    // 0x55 needs no stuffing, so a 62-byte frame encodes to 63 bytes with
+    // COBS / COBS/R and 63 with SLIP (leading END). Both paths hold at most
+    // 63 bytes of a 64-byte buffer.
+    check(fits<COBS, 0>(62), "COBS: a 62-byte frame fits a 64-byte buffer");
+    check(fits<COBSR, 0>(62), "COBSR: a 62-byte frame fits a 64-byte buffer");
+    check(fits<SLIP, SLIP::END>(62), "SLIP: a 62-byte frame fits a 64-byte buffer");
+    check(!fits<COBS, 0>(64), "COBS: a 64-byte frame overflows a 64-byte buffer");
+    check(!fits<COBSR, 0>(64), "COBSR: a 64-byte frame overflows a 64-byte buffer");
+    check(!fits<SLIP, SLIP::END>(64), "SLIP: a 64-byte frame overflows a 64-byte buffer");
+
+    if (failures > 0)
+        return 1;
+
+    printf("reentrant_update: passed\n");
+    return 0;
+}
@@ -0,0 +1,238 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// Differential fuzz test of the SIMD decoders against the scalar ones.
+//
+//     make -C .. check
+//
+// SIMDCOBS::decode() and SIMDSLIP::decode() must return exactly what
+// COBS::decode() and SLIP::decode() return, byte for byte, for any input:
+// valid frames, random bytes and inputs built to hit the edges of the
+// kernels (END / ESC bytes either side of the 16 and 32 byte vector blocks,
+// escapes cut off at the end of the buffer, COBS blocks running past the
+// end). SIMD::findSLIPSpecial() is also compared with a plain loop at every
+// alignment.
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "PacketSerial/Encoding/SIMD.h"
+
+namespace
+{
+    size_t failures = 0;
+    size_t cases = 0;
+
+    void fail(const char* what, const std::vector<uint8_t>& input)
+    {
+        if (failures++ < 10)
+        {
+            fprintf(stderr, "FAIL %s, %zu input bytes:", what, input.size());
+
+            for (size_t i = 0; i < input.size() && i < 64; i++)
+                fprintf(stderr, " %02X", input[i]);
+
+            fprintf(stderr, input.size() > 64 ? " ...\n" : "\n");
+        }
+    }
+
+    /// \brief Decode \p input with both decoders and compare the results.
+    template<typename Scalar, typename Vector>
+    void compare(const char* name, const std::vector<uint8_t>& input)
+    {
+        // Both decoders may write up to one byte per input byte.
+        std::vector<uint8_t> expected(input.size() + 1);
+        std::vector<uint8_t> actual(input.size() + 1);
+
+        size_t expectedSize = Scalar::decode(input.data(), input.size(), expected.data());
+        size_t actualSize = Vector::decode(input.data(), input.size(), actual.data());
+
+        cases++;
+
+        if (expectedSize != actualSize || memcmp(expected.data(), actual.data(), expectedSize) != 0)
+            fail(name, input);
+    }
+
+    void compareAll(const std::vector<uint8_t>& input)
+    {
+        compare<COBS, SIMDCOBS>("SIMDCOBS::decode", input);
+        compare<SLIP, SIMDSLIP>("SIMDSLIP::decode", input);
+
+        size_t expected = 0;
+
+        while (expected < input.size() && input[expected] != SLIP::END && input[expected] != SLIP::ESC)
+            expected++;
+
+        cases++;
+
+        if (SIMD::findSLIPSpecial(input.data(), input.size()) != expected)
+            fail("SIMD::findSLIPSpecial", input);
+    }
+
+    uint8_t randomByte()
+    {
+        return (uint8_t)(rand() & 0xFF);
+    }
+
+    /// \brief A byte that is END or ESC with the given odds in 100.
+    uint8_t slipByte(int specialPercent)
+    {
+        if (rand() % 100 < specialPercent)
+            return (rand() & 1) ? (uint8_t)SLIP::END : (uint8_t)SLIP::ESC;
+
+        uint8_t data;
+
+        do
+            data = randomByte();
+        while (data == SLIP::END || data == SLIP::ESC);
+
+        return data;
+    }
+
+    /// \brief Random payloads, encoded by each encoder and decoded back.
+    void validFrames()
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            size_t size = rand() % 1100;
+            int zeroPercent = rand() % 4 == 0 ? 0 : rand() % 100;
+            std::vector<uint8_t> payload(size);
+
+            for (size_t j = 0; j < size; j++)
+                payload[j] = (rand() % 100 < zeroPercent) ? 0 : slipByte(rand() % 20);
+
+            std::vector<uint8_t> encoded(SLIP::getEncodedBufferSize(size));
+            encoded.resize(COBS::encode(payload.data(), size, encoded.data()));
+            compareAll(encoded);
+
+            encoded.resize(SLIP::getEncodedBufferSize(size));
+            encoded.resize(SLIP::encode(payload.data(), size, encoded.data()));
+            compareAll(encoded);
+        }
+    }
+
+    /// \brief Uniformly random input, mostly malformed.
+    void randomInput()
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            std::vector<uint8_t> input(rand() % 300);
+
+            for (size_t j = 0; j < input.size(); j++)
+                input[j] = randomByte();
+
+            compareAll(input);
+        }
+    }
+
+    /// \brief One END / ESC pair or a lone ESC at every position around the
+    /// vector block edges, followed by every possible byte.
+    void slipEdges()
+    {
+        for (size_t size = 1; size <= 70; size++)
+        {
+            for (size_t position = 0; position < size; position++)
+            {
+                std::vector<uint8_t> input(size);
+
+                for (size_t j = 0; j < size; j++)
+                    input[j] = slipByte(0);
+
+                input[position] = SLIP::END;
+                compareAll(input);
+
+                input[position] = SLIP::ESC;
+                compareAll(input);
+
+                if (position + 1 < size)
+                {
+                    for (int next = 0; next < 256; next++)
+                    {
+                        input[position + 1] = (uint8_t)next;
+                        compareAll(input);
+                    }
+                }
+            }
+        }
+    }
+
+    /// \brief Dense END / ESC runs, where most escapes are malformed.
+    void slipDense()
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            std::vector<uint8_t> input(rand() % 200);
+
+            for (size_t j = 0; j < input.size(); j++)
+            {
+                int choice = rand() % 4;
+                input[j] = choice == 0 ? (uint8_t)SLIP::ESC_END
+                         : choice == 1 ? (uint8_t)SLIP::ESC_ESC
+                         : slipByte(80);
+            }
+
+            compareAll(input);
+        }
+    }
+
+    /// \brief COBS blocks whose code bytes are off by one, zero, 0xFF or
+    /// point past the end of the frame.
+    void cobsEdges()
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            std::vector<uint8_t> input;
+            size_t blocks = rand() % 6 + 1;
+
+            for (size_t block = 0; block < blocks; block++)
+            {
+                size_t length = rand() % 3 == 0 ? 254 : rand() % 40;
+                int error = rand() % 6;
+                uint8_t code = (uint8_t)(length + 1);
+
+                if (error == 0)
+                    code++;
+                else if (error == 1)
+                    code--;
+                else if (error == 2)
+                    code = (uint8_t)(rand() % 3 == 0 ? 0 : 0xFF);
+
+                input.push_back(code);
+
+                for (size_t j = 0; j < length; j++)
+                    input.push_back((uint8_t)(rand() % 255 + 1));
+            }
+
+            // Cut the frame short now and then.
+            if (rand() % 3 == 0 && !input.empty())
+                input.resize(rand() % input.size());
+
+            compareAll(input);
+        }
+    }
+}
+
+int main()
+{
+    srand(1);
+
+    validFrames();
+    randomInput();
+    slipEdges();
+    slipDense();
+    cobsEdges();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "simd_fuzz: %zu of %zu cases failed (kernel %s)\n", failures, cases, SIMD::kernelName());
+        return 1;
+    }
+
+    printf("simd_fuzz: %zu cases passed (kernel %s)\n", cases, SIMD::kernelName());
+    return 0;
+}
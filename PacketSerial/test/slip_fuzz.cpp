@@ -0,0 +1,245 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// Fuzz test of the single-pass SLIP decoders.
+//
+//     make -C .. check
+//
+// For any input, SLIP::decode() must return, read each byte once and write
+// no more bytes than it read, and SLIP::StreamDecoder fed the same bytes
+// must agree with it: the same bytes for a valid frame, finish() false
+// where decode() reports a protocol violation. The stream decoder must
+// never write past the capacity it is given, and one decoder is reused
+// across all cases, so a malformed frame must not affect the next. Valid
+// frames must also survive encode(), decode() and decodeInPlace().
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "PacketSerial/Encoding/SLIP.h"
+
+namespace
+{
+    enum
+    {
+        /// \brief Bytes written past the end of a buffer land here.
+        Guard = 16,
+        GuardByte = 0xA5
+    };
+
+    size_t failures = 0;
+    size_t cases = 0;
+
+    SLIP::StreamDecoder streamDecoder;
+
+    void fail(const char* what, const std::vector<uint8_t>& input)
+    {
+        if (failures++ < 10)
+        {
+            fprintf(stderr, "FAIL %s, %zu input bytes:", what, input.size());
+
+            for (size_t i = 0; i < input.size() && i < 64; i++)
+                fprintf(stderr, " %02X", input[i]);
+
+            fprintf(stderr, input.size() > 64 ? " ...\n" : "\n");
+        }
+    }
+
+    /// \brief Compare \p size bytes. memcmp() must not be passed the null
+    /// data() of an empty vector, even for a size of 0.
+    bool same(const uint8_t* a, const uint8_t* b, size_t size)
+    {
+        return size == 0 || memcmp(a, b, size) == 0;
+    }
+
+    bool guardIntact(const std::vector<uint8_t>& buffer, size_t size)
+    {
+        for (size_t i = size; i < buffer.size(); i++)
+        {
+            if (buffer[i] != GuardByte)
+                return false;
+        }
+
+        return true;
+    }
+
+    /// \brief Decode \p input with decode(), decodeInPlace() and the stream
+    /// decoder and compare the results.
+    void check(const std::vector<uint8_t>& input)
+    {
+        std::vector<uint8_t> decoded(input.size() + Guard, GuardByte);
+        size_t decodedSize = SLIP::decode(input.data(), input.size(), decoded.data());
+
+        cases++;
+
+        if (decodedSize > input.size() || !guardIntact(decoded, input.size()))
+            fail("SLIP::decode wrote past the input size", input);
+
+        std::vector<uint8_t> inPlace(input);
+        inPlace.resize(input.size() + Guard, GuardByte);
+
+        cases++;
+
+        if (SLIP::decodeInPlace(inPlace.data(), input.size()) != decodedSize
+            || !same(inPlace.data(), decoded.data(), decodedSize)
+            || !guardIntact(inPlace, input.size()))
+            fail("SLIP::decodeInPlace differs from decode", input);
+
+        std::vector<uint8_t> streamed(input.size() + Guard, GuardByte);
+        size_t streamedSize = 0;
+        bool fits = true;
+
+        for (size_t i = 0; i < input.size(); i++)
+            fits = streamDecoder.push(input[i], streamed.data(), streamedSize, input.size()) && fits;
+
+        bool valid = streamDecoder.finish();
+
+        cases++;
+
+        if (!fits || !guardIntact(streamed, input.size()))
+            fail("SLIP::StreamDecoder wrote past the input size", input);
+        else if (valid && (streamedSize != decodedSize || !same(streamed.data(), decoded.data(), decodedSize)))
+            fail("SLIP::StreamDecoder differs from decode", input);
+        else if (!valid && decodedSize != 0)
+            fail("SLIP::StreamDecoder rejected a frame decode accepted", input);
+
+        // Too small a buffer: the decoder must stop at the capacity and
+        // report it, and still be in step for the next frame.
+        if (decodedSize > 0)
+        {
+            size_t capacity = decodedSize - 1;
+            std::vector<uint8_t> small(capacity + Guard, GuardByte);
+            size_t smallSize = 0;
+            bool smallFits = true;
+
+            for (size_t i = 0; i < input.size(); i++)
+                smallFits = streamDecoder.push(input[i], small.data(), smallSize, capacity) && smallFits;
+
+            streamDecoder.finish();
+
+            cases++;
+
+            if (smallFits || smallSize != capacity || !guardIntact(small, capacity)
+                || !same(small.data(), decoded.data(), capacity))
+                fail("SLIP::StreamDecoder overran a small buffer", input);
+        }
+    }
+
+    uint8_t randomByte()
+    {
+        return (uint8_t)(rand() & 0xFF);
+    }
+
+    /// \brief A byte that is END, ESC, ESC_END or ESC_ESC most of the time.
+    uint8_t slipByte()
+    {
+        static const uint8_t special[] = { SLIP::END, SLIP::ESC, SLIP::ESC_END, SLIP::ESC_ESC };
+
+        return (rand() % 5 == 0) ? randomByte() : special[rand() % 4];
+    }
+
+    /// \brief Encode random payloads; they must decode to themselves.
+    void roundTrip()
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            std::vector<uint8_t> payload(rand() % 300);
+
+            for (size_t j = 0; j < payload.size(); j++)
+                payload[j] = (rand() % 3 == 0) ? slipByte() : randomByte();
+
+            std::vector<uint8_t> encoded(SLIP::getEncodedBufferSize(payload.size()));
+            encoded.resize(SLIP::encode(payload.data(), payload.size(), encoded.data()));
+
+            std::vector<uint8_t> decoded(encoded.size() + 1);
+            size_t decodedSize = SLIP::decode(encoded.data(), encoded.size(), decoded.data());
+
+            cases++;
+
+            if (decodedSize != payload.size() || !same(decoded.data(), payload.data(), decodedSize))
+                fail("SLIP round trip", payload);
+
+            check(encoded);
+        }
+    }
+
+    /// \brief Random bytes of every length up to 64, then longer.
+    void randomInput()
+    {
+        for (int i = 0; i < 200000; i++)
+        {
+            std::vector<uint8_t> input(i < 100000 ? rand() % 65 : rand() % 1024);
+
+            for (size_t j = 0; j < input.size(); j++)
+                input[j] = randomByte();
+
+            check(input);
+        }
+    }
+
+    /// \brief Input made mostly of END / ESC / ESC_END / ESC_ESC, to hit
+    /// escapes followed by anything, doubled escapes and a trailing ESC.
+    void escapeHeavy()
+    {
+        for (int i = 0; i < 200000; i++)
+        {
+            std::vector<uint8_t> input(rand() % 40);
+
+            for (size_t j = 0; j < input.size(); j++)
+                input[j] = slipByte();
+
+            check(input);
+        }
+    }
+
+    /// \brief Every input of up to three bytes drawn from the special
+    /// bytes plus one ordinary byte.
+    void exhaustive()
+    {
+        static const uint8_t bytes[] = { SLIP::END, SLIP::ESC, SLIP::ESC_END, SLIP::ESC_ESC, 0x00 };
+        const size_t count = sizeof(bytes);
+
+        for (size_t length = 0; length <= 3; length++)
+        {
+            size_t combinations = 1;
+
+            for (size_t i = 0; i < length; i++)
+                combinations *= count;
+
+            for (size_t n = 0; n < combinations; n++)
+            {
+                std::vector<uint8_t> input(length);
+                size_t digits = n;
+
+                for (size_t i = 0; i < length; i++, digits /= count)
+                    input[i] = bytes[digits % count];
+
+                check(input);
+            }
+        }
+    }
+}
+
+int main()
+{
+    srand(1);
+
+    exhaustive();
+    roundTrip();
+    randomInput();
+    escapeHeavy();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "slip_fuzz: %zu of %zu cases failed\n", failures, cases);
+        return 1;
+    }
+
+    printf("slip_fuzz: %zu cases passed\n", cases);
+    return 0;
+}
@@ -0,0 +1,169 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// The PacketSerialStats frame counters against the frames on the wire.
+//
+//     make -C .. check
+//
+// Every frame a link decodes is either received (passed to the handler or
+// stored for poll()) or dropped for want of a receive slot, never both, so
+// framesReceived plus receiveDropCount() must equal the frames sent. Empty
+// frames, such as the END that starts every SLIP frame, count as neither.
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define PACKETSERIAL_HOST
+#include "PacketSerial/PacketSerial.h"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "FAIL %s\n", what);
+            failures++;
+        }
+    }
+
+    /// \brief Bytes written to it can be read back.
+    class MemoryStream
+    {
+    public:
+        MemoryStream():
+            _readIndex(0)
+        {
+        }
+
+        int available() const
+        {
+            return (int)(_data.size() - _readIndex);
+        }
+
+        int read()
+        {
+            return _readIndex < _data.size() ? _data[_readIndex++] : -1;
+        }
+
+        size_t write(uint8_t data)
+        {
+            _data.push_back(data);
+            return 1;
+        }
+
+    private:
+        std::vector<uint8_t> _data;
+        size_t _readIndex;
+    };
+
+    /// \brief Two receive slots, so a burst of frames overflows them.
+    struct QueuedOptions: PacketSerialDefaultOptions
+    {
+        enum { ReceiveSlots = 2 };
+        typedef MemoryStream StreamType;
+        typedef PacketSerialStats StatsType;
+    };
+
+    /// \brief Frames go to a handler, which cannot drop them.
+    struct HandlerOptions: PacketSerialDefaultOptions
+    {
+        typedef MemoryStream StreamType;
+        typedef PacketSerialStats StatsType;
+    };
+
+    size_t handled = 0;
+
+    void onPacket(const uint8_t*, size_t size)
+    {
+        // The handler still sees the empty frames.
+        if (size > 0)
+            handled++;
+    }
+
+    /// \brief Send \p count frames of 8 bytes over \p link.
+    template<typename Link>
+    void sendFrames(Link& link, size_t count)
+    {
+        uint8_t frame[8];
+
+        for (size_t i = 0; i < count; i++)
+        {
+            memset(frame, (int)i + 1, sizeof(frame));
+            link.send(frame, sizeof(frame));
+        }
+    }
+
+    /// \returns true if every frame on the wire so far is counted once.
+    template<typename Link>
+    bool accounted(const Link& link, uint32_t frames)
+    {
+        return link.stats().framesReceived + link.receiveDropCount() == frames;
+    }
+
+    void queued()
+    {
+        typedef PacketSerial_<COBS, 0, 256, false, NoFrameCheck, QueuedOptions> Link;
+
+        MemoryStream stream;
+        Link link;
+        link.setStream(&stream);
+
+        // Five frames into two slots: two stored, three dropped.
+        sendFrames(link, 5);
+        link.update();
+
+        check(link.stats().framesReceived == 2, "queued: the stored frames are received");
+        check(link.receiveDropCount() == 3, "queued: the frames without a slot are dropped");
+        check(accounted(link, 5), "queued: received plus dropped is the frames sent");
+        check(link.stats().bytesReceived == 2 * 8, "queued: dropped frames add no bytes");
+
+        // Freeing the slots lets the next frames through.
+        link.release();
+        link.release();
+        sendFrames(link, 1);
+        link.update();
+
+        check(link.stats().framesReceived == 3, "queued: a frame after release() is received");
+        check(accounted(link, 6), "queued: received plus dropped is still the frames sent");
+
+        PacketSerialStatsPacket packet = link.statsPacket(0xF1);
+        check(packet.framesReceived + packet.receiveDrops == 6, "queued: the stats packet adds up too");
+    }
+
+    void handler()
+    {
+        typedef PacketSerial_<SLIP, SLIP::END, 256, false, NoFrameCheck, HandlerOptions> Link;
+
+        MemoryStream stream;
+        Link link;
+        link.setStream(&stream);
+        link.setPacketHandler(&onPacket);
+
+        sendFrames(link, 5);
+        link.update();
+
+        check(handled == 5, "handler: every frame is handled");
+        check(link.stats().framesReceived == 5, "handler: the empty frames before each END are not counted");
+        check(accounted(link, 5), "handler: received plus dropped is the frames sent");
+    }
+}
+
+
+int main()
+{
+    queued();
+    handler();
+
+    if (failures > 0)
+        return 1;
+
+    printf("stats: passed\n");
+    return 0;
+}
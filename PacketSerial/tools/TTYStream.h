@@ -0,0 +1,211 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+/// \brief A Linux tty (a USB serial adapter, a UART or a pty) as a
+/// PacketSerial_ `StreamType`, for the host tools.
+///
+/// The port is opened non-blocking in raw mode, so available() and
+/// readBytes() never wait. Wait for input with poll() on fd() instead.
+class TTYStream
+{
+public:
+    TTYStream():
+        _fd(-1)
+    {
+    }
+
+    ~TTYStream()
+    {
+        close();
+    }
+
+    /// \brief Open a tty and set it to raw 8N1 at the given speed.
+    /// \param path The device, e.g. `/dev/ttyUSB0`.
+    /// \param speed The speed in bits / second, or 0 to keep the current
+    ///        speed, e.g. for a pty.
+    /// \returns false if the device could not be opened or set up, or the
+    ///          speed is not one the tty supports. errno tells which.
+    bool open(const char* path, unsigned long speed)
+    {
+        close();
+
+        speed_t baud = _baud(speed);
+
+        if (speed != 0 && baud == 0)
+        {
+            errno = EINVAL;
+            return false;
+        }
+
+        _fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+        if (_fd < 0)
+            return false;
+
+        termios tty;
+
+        if (tcgetattr(_fd, &tty) != 0)
+        {
+            close();
+            return false;
+        }
+
+        cfmakeraw(&tty);
+        tty.c_cflag |= CLOCAL | CREAD;
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = 0;
+
+        if (baud != 0)
+        {
+            cfsetispeed(&tty, baud);
+            cfsetospeed(&tty, baud);
+        }
+
+        if (tcsetattr(_fd, TCSANOW, &tty) != 0)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    /// \returns true if open() can set the tty to \p speed, or \p speed is
+    ///          0 to keep the current one.
+    static bool supportsSpeed(unsigned long speed)
+    {
+        return speed == 0 || _baud(speed) != 0;
+    }
+
+    /// \brief Use an already open descriptor, such as the master side of a
+    /// pty pair. The stream closes it.
+    void attach(int fd)
+    {
+        close();
+
+        _fd = fd;
+        fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    void close()
+    {
+        if (_fd >= 0)
+            ::close(_fd);
+
+        _fd = -1;
+    }
+
+    /// \returns the file descriptor, for poll() / epoll.
+    int fd() const
+    {
+        return _fd;
+    }
+
+    /// \returns the number of bytes that can be read without waiting.
+    int available()
+    {
+        int size = 0;
+
+        if (ioctl(_fd, FIONREAD, &size) != 0)
+            return 0;
+
+        return size;
+    }
+
+    /// \returns the next byte, or -1 if there is none.
+    int read()
+    {
+        uint8_t data;
+        return (::read(_fd, &data, 1) == 1) ? data : -1;
+    }
+
+    /// \brief Read up to \p size bytes.
+    /// \returns the number of bytes read.
+    size_t readBytes(uint8_t* buffer, size_t size)
+    {
+        ssize_t count = ::read(_fd, buffer, size);
+        return count > 0 ? (size_t)count : 0;
+    }
+
+    /// \brief Write one byte, waiting while the port is busy.
+    size_t write(uint8_t data)
+    {
+        return write(&data, 1);
+    }
+
+    /// \brief Write \p size bytes, waiting while the port is busy.
+    ///
+    /// PacketSerial_ uses this to write a frame in blocks rather than one
+    /// write() call per byte. A full output buffer is waited out in poll(),
+    /// not by retrying the write in a loop.
+    ///
+    /// \returns the number of bytes written, less than \p size only on an
+    ///          error.
+    size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t index = 0;
+
+        while (index < size)
+        {
+            ssize_t count = ::write(_fd, buffer + index, size - index);
+
+            if (count > 0)
+            {
+                index += count;
+                continue;
+            }
+
+            if (count < 0 && errno == EINTR)
+                continue;
+
+            if (count < 0 && errno != EAGAIN)
+                break;
+
+            pollfd writable = { _fd, POLLOUT, 0 };
+
+            if (poll(&writable, 1, -1) < 0 && errno != EINTR)
+                break;
+
+            if (writable.revents & (POLLERR | POLLHUP | POLLNVAL))
+                break;
+        }
+
+        return index;
+    }
+
+private:
+    TTYStream(const TTYStream&);
+    TTYStream& operator = (const TTYStream&);
+
+    static speed_t _baud(unsigned long speed)
+    {
+        switch (speed)
+        {
+            case 9600: return B9600;
+            case 19200: return B19200;
+            case 38400: return B38400;
+            case 57600: return B57600;
+            case 115200: return B115200;
+            case 230400: return B230400;
+            case 460800: return B460800;
+            case 921600: return B921600;
+            case 1000000: return B1000000;
+            default: return 0;
+        }
+    }
+
+    int _fd;
+};
@@ -0,0 +1,821 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// Native Linux gateway from a PacketSerial_ link to local consumers.
+//
+// Reads a tty or pty with epoll, decodes the DeviceData structs from
+// SensorPacket.h with the same PacketSerial_, COBS / SLIP and
+// DeviceData::Router templates as the firmware, and writes one JSON object
+// per frame to stdout, a file and / or the clients of a Unix socket:
+//
+//     g++ -std=c++11 -O2 -I../.. -o gateway gateway.cpp -lutil
+//     ./gateway [options] /dev/ttyUSB0 [baud]
+//     ./gateway -g 10 -o /dev/null [options] [baud]
+//
+// Options:
+//
+//     -e   the link encoding, cobs (default) or slip
+//     -l   the structs are little-endian (the JN516x is big-endian)
+//     -o   write to this file instead of stdout, - for stdout
+//     -s   also serve the output on this Unix socket path
+//     -c   grant this many frames of credit (see PacketCredit.h)
+//     -r   the report interval in seconds (default 5)
+//     -g   generate traffic for this many seconds, see below
+//
+// Every report interval, frames/s, bytes/s, the CPU time used by the
+// gateway (as a percentage of one core) and the error counters are
+// printed to stderr.
+//
+// With -g there is no hardware: the gateway opens a pty pair and forks a
+// child that plays the master board, sending big-endian IMU, GPS, servo,
+// pitot and vane frames into the pty through a PacketSerial_ paced at the
+// given baud rate (0 for as fast as possible). The gateway reads the other
+// side exactly as it would read a real tty. With -c the child sends
+// through a PacketCreditSender.
+//
+// Slow socket clients are disconnected rather than allowed to stall the
+// gateway. The struct layouts are assumed to match on both sides, which
+// holds for SensorPacket.h on the JN516x and on x86 / ARM Linux.
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pty.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define PACKETSERIAL_HOST
+#include "PacketSerial/PacketSerial.h"
+#include "PacketSerial/PacketCredit.h"
+#include "PacketSerial/tools/TTYStream.h"
+#include "DeviceRouter.h"
+
+namespace
+{
+    /// \brief Byte-swap one value.
+    template<typename T>
+    void swapValue(T& value)
+    {
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(&value);
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+
+    template<typename T, size_t N>
+    void swapValue(T (&values)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+            swapValue(values[i]);
+    }
+
+    /// \brief Convert each multi-byte field between the wire and host order.
+    void swapFields(DeviceData::ServoData& data)
+    {
+        swapValue(data.timestamp);
+        swapValue(data.rudder);
+        swapValue(data.elevator);
+        swapValue(data.voltage);
+        swapValue(data.rudder_current);
+        swapValue(data.elevator_current);
+        swapValue(data.trim);
+    }
+
+    void swapFields(DeviceData::TachometerData& data)
+    {
+        swapValue(data.timestamp);
+        swapValue(data.strain);
+        swapValue(data.rpm);
+    }
+
+    void swapFields(DeviceData::PitotData& data)
+    {
+        swapValue(data.timestamp);
+        swapValue(data.pressure);
+        swapValue(data.temperature);
+        swapValue(data.velocity);
+    }
+
+    void swapFields(DeviceData::IMUData& data)
+    {
+        swapValue(data.calib);
+        swapValue(data.timestamp);
+        swapValue(data.q);
+        swapValue(data.m);
+        swapValue(data.a);
+        swapValue(data.g);
+        swapValue(data.q1);
+        swapValue(data.m1);
+        swapValue(data.a1);
+        swapValue(data.g1);
+        swapValue(data.q2);
+        swapValue(data.m2);
+        swapValue(data.a2);
+        swapValue(data.g2);
+    }
+
+    void swapFields(DeviceData::UltraSonicData& data)
+    {
+        swapValue(data.timestamp);
+        swapValue(data.altitude);
+    }
+
+    void swapFields(DeviceData::GPSData& data)
+    {
+        swapValue(data.timestamp);
+        swapValue(data.latitude);
+        swapValue(data.longitude);
+        swapValue(data.vx);
+        swapValue(data.vy);
+    }
+
+    void swapFields(DeviceData::VaneData& data)
+    {
+        swapValue(data.timestamp);
+        swapValue(data.angle);
+    }
+
+    void swapFields(DeviceData::BarometerData& data)
+    {
+        swapValue(data.timestamp);
+        swapValue(data.pressure);
+        swapValue(data.temperature);
+    }
+
+    bool hostIsBigEndian()
+    {
+        uint16_t value = 1;
+        return *reinterpret_cast<uint8_t*>(&value) == 0;
+    }
+
+    /// \brief One JSON object, built field by field.
+    class Line
+    {
+    public:
+        Line(std::string& out, const char* type, uint8_t id, uint32_t timestamp):
+            _out(out)
+        {
+            _printf("{\"type\":\"%s\",\"id\":%u,\"board\":%u,\"timestamp\":%u", type, id, id & 0x0F, timestamp);
+        }
+
+        ~Line()
+        {
+            _out += "}\n";
+        }
+
+        void field(const char* name, double value)
+        {
+            _printf(",\"%s\":%.9g", name, value);
+        }
+
+        template<size_t N>
+        void field(const char* name, const short (&values)[N])
+        {
+            _printf(",\"%s\":[", name);
+
+            for (size_t i = 0; i < N; i++)
+                _printf(i ? ",%d" : "%d", values[i]);
+
+            _out += "]";
+        }
+
+    private:
+        void _printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+        {
+            char buffer[128];
+            va_list args;
+            va_start(args, format);
+            int size = vsnprintf(buffer, sizeof(buffer), format, args);
+            va_end(args);
+
+            if (size > 0)
+                _out.append(buffer, std::min((size_t)size, sizeof(buffer) - 1));
+        }
+
+        std::string& _out;
+    };
+
+    /// \brief The DeviceData::Router handler: appends each struct as JSON.
+    struct Printer
+    {
+        std::string* out;
+        bool swap;
+
+        template<typename T>
+        T toHost(const T& wire) const
+        {
+            T data = wire;
+
+            if (swap)
+                swapFields(data);
+
+            return data;
+        }
+
+        void operator()(const DeviceData::ServoData& wire) const
+        {
+            DeviceData::ServoData data = toHost(wire);
+            Line line(*out, "Servo", data.id, data.timestamp);
+            line.field("rudder", data.rudder);
+            line.field("elevator", data.elevator);
+            line.field("voltage", data.voltage);
+            line.field("rudder_current", data.rudder_current);
+            line.field("elevator_current", data.elevator_current);
+            line.field("trim", data.trim);
+            line.field("status", data.status);
+        }
+
+        void operator()(const DeviceData::TachometerData& wire) const
+        {
+            DeviceData::TachometerData data = toHost(wire);
+            Line line(*out, "Tachometer", data.id, data.timestamp);
+            line.field("strain", data.strain);
+            line.field("rpm", data.rpm);
+        }
+
+        void operator()(const DeviceData::PitotData& wire) const
+        {
+            DeviceData::PitotData data = toHost(wire);
+            Line line(*out, "Pitot", data.id, data.timestamp);
+            line.field("pressure", data.pressure);
+            line.field("temperature", data.temperature);
+            line.field("velocity", data.velocity);
+        }
+
+        void operator()(const DeviceData::IMUData& wire) const
+        {
+            DeviceData::IMUData data = toHost(wire);
+            Line line(*out, "IMU", data.id, data.timestamp);
+            line.field("calib", data.calib);
+            line.field("q", data.q);
+            line.field("m", data.m);
+            line.field("a", data.a);
+            line.field("g", data.g);
+            line.field("q1", data.q1);
+            line.field("m1", data.m1);
+            line.field("a1", data.a1);
+            line.field("g1", data.g1);
+            line.field("q2", data.q2);
+            line.field("m2", data.m2);
+            line.field("a2", data.a2);
+            line.field("g2", data.g2);
+        }
+
+        void operator()(const DeviceData::UltraSonicData& wire) const
+        {
+            DeviceData::UltraSonicData data = toHost(wire);
+            Line line(*out, "UltraSonic", data.id, data.timestamp);
+            line.field("altitude", data.altitude);
+        }
+
+        void operator()(const DeviceData::GPSData& wire) const
+        {
+            DeviceData::GPSData data = toHost(wire);
+            Line line(*out, "GPS", data.id, data.timestamp);
+            line.field("latitude", data.latitude);
+            line.field("longitude", data.longitude);
+            line.field("vx", data.vx);
+            line.field("vy", data.vy);
+        }
+
+        void operator()(const DeviceData::VaneData& wire) const
+        {
+            DeviceData::VaneData data = toHost(wire);
+            Line line(*out, "Vane", data.id, data.timestamp);
+            line.field("angle", data.angle);
+        }
+
+        void operator()(const DeviceData::BarometerData& wire) const
+        {
+            DeviceData::BarometerData data = toHost(wire);
+            Line line(*out, "Barometer", data.id, data.timestamp);
+            line.field("pressure", data.pressure);
+            line.field("temperature", data.temperature);
+        }
+    };
+
+    typedef DeviceData::Router<Printer,
+                               DeviceData::ServoData,
+                               DeviceData::TachometerData,
+                               DeviceData::PitotData,
+                               DeviceData::IMUData,
+                               DeviceData::UltraSonicData,
+                               DeviceData::GPSData,
+                               DeviceData::VaneData,
+                               DeviceData::BarometerData> Router;
+
+    /// \brief The PacketSerial_ HandlerType: counts and routes each frame.
+    struct GatewayHandler
+    {
+        Router* router;
+        uint64_t* frames;
+        uint64_t* bytes;
+
+        void operator()(const uint8_t* buffer, size_t size) const
+        {
+            // Grants only travel towards the master; anything else with
+            // the grant id is not a DeviceData frame either.
+            if (size == 0 || buffer[0] == PacketCreditGrant::ID)
+                return;
+
+            (*frames)++;
+            *bytes += size;
+            (*router)(buffer, size);
+        }
+    };
+
+    /// \brief Where the JSON lines go: a file and the Unix socket clients.
+    class Output
+    {
+    public:
+        Output():
+            _file(stdout),
+            _listen(-1)
+        {
+        }
+
+        bool openFile(const char* path)
+        {
+            if (strcmp(path, "-") == 0)
+                return true;
+
+            _file = fopen(path, "w");
+            return _file != nullptr;
+        }
+
+        bool listen(const char* path)
+        {
+            sockaddr_un address;
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+
+            if (strlen(path) >= sizeof(address.sun_path))
+                return false;
+
+            strcpy(address.sun_path, path);
+            unlink(path);
+
+            _listen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+            return _listen >= 0
+                && bind(_listen, (sockaddr*)&address, sizeof(address)) == 0
+                && ::listen(_listen, 8) == 0;
+        }
+
+        int listenFd() const
+        {
+            return _listen;
+        }
+
+        void accept()
+        {
+            int client;
+
+            while ((client = accept4(_listen, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+                _clients.push_back(client);
+        }
+
+        std::string& buffer()
+        {
+            return _buffer;
+        }
+
+        /// \brief Write out the lines collected so far.
+        void flush()
+        {
+            if (_buffer.empty())
+                return;
+
+            fwrite(_buffer.data(), 1, _buffer.size(), _file);
+            fflush(_file);
+
+            for (size_t i = 0; i < _clients.size(); )
+            {
+                ssize_t sent = send(_clients[i], _buffer.data(), _buffer.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+
+                if (sent == (ssize_t)_buffer.size())
+                {
+                    i++;
+                    continue;
+                }
+
+                // Gone, or too slow to keep up.
+                close(_clients[i]);
+                _clients.erase(_clients.begin() + i);
+            }
+
+            _buffer.clear();
+        }
+
+    private:
+        FILE* _file;
+        int _listen;
+        std::vector<int> _clients;
+        std::string _buffer;
+    };
+
+    volatile sig_atomic_t stopping = 0;
+
+    void onSignal(int)
+    {
+        stopping = 1;
+    }
+
+    double cpuSeconds()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+             + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    }
+
+    double wallSeconds()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+    }
+
+    struct Options
+    {
+        const char* encoding = "cobs";
+        const char* outputPath = "-";
+        const char* socketPath = nullptr;
+        bool littleEndian = false;
+        uint16_t creditWindow = 0;
+        double reportSeconds = 5;
+        double generateSeconds = 0;
+        unsigned long baud = 115200;
+    };
+
+    /// \brief Collects the output of the PacketSerial_ writes of the
+    /// generator, so each frame is one write() to the pty.
+    struct FrameBuffer
+    {
+        TTYStream* tty;
+        std::vector<uint8_t> data;
+
+        int available()
+        {
+            return tty->available();
+        }
+
+        int read()
+        {
+            return tty->read();
+        }
+
+        size_t write(uint8_t byte)
+        {
+            data.push_back(byte);
+            return 1;
+        }
+
+        void flush()
+        {
+            tty->write(data.data(), data.size());
+            data.clear();
+        }
+    };
+
+    template<typename EncoderType, uint8_t PacketMarker>
+    struct Generator
+    {
+        typedef PacketSerial_<EncoderType, PacketMarker, 256, false, NoFrameCheck, PacketSerialOptions<void, FrameBuffer> > Link;
+
+        static PacketCreditSender<Link>* credit;
+
+        static void onPacket(const uint8_t* buffer, size_t size)
+        {
+            if (credit)
+                credit->receive(buffer, size);
+        }
+
+        template<typename T>
+        static void send(Link& link, T data, bool swap)
+        {
+            if (swap)
+                swapFields(data);
+
+            if (credit)
+                credit->send(data);
+            else
+                link.send(data);
+        }
+
+        /// \brief Play the master board: send frames for \p seconds.
+        static void run(const char* path, const Options& options)
+        {
+            TTYStream tty;
+
+            // The baud rate only paces the generator; a pty has no speed.
+            if (!tty.open(path, 0))
+                _exit(1);
+
+            FrameBuffer buffer = { &tty, std::vector<uint8_t>() };
+            Link link(buffer);
+            link.setPacketHandler(&onPacket);
+
+            PacketCreditSender<Link> sender(link);
+
+            if (options.creditWindow > 0)
+                credit = &sender;
+
+            bool swap = hostIsBigEndian() == options.littleEndian;
+
+            DeviceData::IMUData imu;
+            DeviceData::GPSData gps;
+            DeviceData::ServoData servo;
+            DeviceData::PitotData pitot;
+            DeviceData::VaneData vane;
+            memset(&imu, 0, sizeof(imu));
+            memset(&gps, 0, sizeof(gps));
+            memset(&servo, 0, sizeof(servo));
+            memset(&pitot, 0, sizeof(pitot));
+            memset(&vane, 0, sizeof(vane));
+            imu.id = DeviceData::IMU;
+            gps.id = DeviceData::GPS;
+            servo.id = DeviceData::ServoController;
+            pitot.id = DeviceData::Pitot | 1;
+            vane.id = DeviceData::Vane;
+
+            double start = wallSeconds();
+            double bytesPerSecond = options.baud / 10.0;
+            uint64_t written = 0;
+
+            for (uint32_t i = 0; wallSeconds() - start < options.generateSeconds; i++)
+            {
+                uint32_t now = PacketSerialMillis();
+
+                imu.timestamp = gps.timestamp = servo.timestamp = pitot.timestamp = vane.timestamp = now;
+                imu.calib = 0xFF;
+                imu.q[0] = (short)i;
+                imu.a[2] = -980;
+                gps.latitude = 35.2 + i * 1e-7;
+                gps.longitude = 136.1;
+                servo.rudder = (float)(i % 100) / 10;
+                pitot.velocity = 8.5f;
+                vane.angle = (float)(i % 360);
+
+                send(link, imu, swap);
+                send(link, servo, swap);
+                send(link, pitot, swap);
+
+                if (i % 4 == 0)
+                    send(link, vane, swap);
+
+                if (i % 10 == 0)
+                    send(link, gps, swap);
+
+                written += buffer.data.size();
+                buffer.flush();
+                link.update();
+
+                if (bytesPerSecond > 0)
+                {
+                    double ahead = written / bytesPerSecond - (wallSeconds() - start);
+
+                    if (ahead > 0)
+                        usleep((useconds_t)(ahead * 1e6));
+                }
+            }
+
+            _exit(0);
+        }
+    };
+
+    template<typename EncoderType, uint8_t PacketMarker>
+    PacketCreditSender<typename Generator<EncoderType, PacketMarker>::Link>* Generator<EncoderType, PacketMarker>::credit = nullptr;
+
+    template<typename EncoderType, uint8_t PacketMarker>
+    int run(const char* path, const Options& options)
+    {
+        typedef PacketSerial_<EncoderType, PacketMarker, 256, false, NoFrameCheck, PacketSerialOptions<GatewayHandler, TTYStream> > Link;
+
+        TTYStream tty;
+        pid_t child = -1;
+
+        if (options.generateSeconds > 0)
+        {
+            int master;
+            int slave;
+            char name[64];
+
+            if (openpty(&master, &slave, name, nullptr, nullptr) != 0)
+            {
+                perror("openpty");
+                return 1;
+            }
+
+            child = fork();
+
+            if (child == 0)
+            {
+                close(master);
+                Generator<EncoderType, PacketMarker>::run(name, options);
+            }
+
+            // Keep the slave open until the child has opened it, by
+            // closing it only once the master is set up.
+            tty.attach(master);
+            close(slave);
+        }
+        else if (!tty.open(path, options.baud))
+        {
+            perror(path);
+            return 1;
+        }
+
+        Output output;
+
+        if (!output.openFile(options.outputPath))
+        {
+            perror(options.outputPath);
+            return 1;
+        }
+
+        if (options.socketPath && !output.listen(options.socketPath))
+        {
+            perror(options.socketPath);
+            return 1;
+        }
+
+        Printer printer = { &output.buffer(), hostIsBigEndian() == options.littleEndian };
+        Router router(printer);
+
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        GatewayHandler handler = { &router, &frames, &bytes };
+        Link link(tty, handler);
+
+        // A new epoch each run, so a sender that outlives the gateway
+        // starts counting from 0 with it.
+        PacketCreditReceiver<Link> credit(link, options.creditWindow, 50, (uint8_t)(time(nullptr) ^ getpid()));
+
+        int epoll = epoll_create1(0);
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = tty.fd();
+        epoll_ctl(epoll, EPOLL_CTL_ADD, tty.fd(), &event);
+
+        if (output.listenFd() >= 0)
+        {
+            event.data.fd = output.listenFd();
+            epoll_ctl(epoll, EPOLL_CTL_ADD, output.listenFd(), &event);
+        }
+
+        double reportStart = wallSeconds();
+        double reportCpu = cpuSeconds();
+        uint64_t reportFrames = 0;
+        uint64_t reportBytes = 0;
+        double runStart = reportStart;
+        double runCpu = reportCpu;
+        bool hungUp = false;
+
+        while (!stopping && !hungUp)
+        {
+            epoll_event events[4];
+            int count = epoll_wait(epoll, events, 4, 100);
+
+            for (int i = 0; i < count; i++)
+            {
+                if (events[i].data.fd == output.listenFd())
+                    output.accept();
+                else if ((events[i].events & (EPOLLHUP | EPOLLERR)) && tty.available() == 0)
+                    hungUp = true;
+            }
+
+            uint64_t before = frames;
+            size_t errorsBefore = link.decodeErrorCount() + link.checksumErrorCount();
+            link.update();
+
+            // Frames dropped as errors were sent with a credit too.
+            uint32_t errors = (uint32_t)(link.decodeErrorCount() + link.checksumErrorCount() - errorsBefore);
+
+            if (options.creditWindow > 0)
+                credit.received((uint32_t)(frames - before) + errors);
+
+            output.flush();
+
+            if (options.creditWindow > 0)
+            {
+                credit.consumed((uint32_t)(frames - before) + errors);
+                credit.update();
+            }
+
+            double now = wallSeconds();
+
+            if (now - reportStart >= options.reportSeconds)
+            {
+                double elapsed = now - reportStart;
+                double cpu = cpuSeconds();
+
+                fprintf(stderr, "%.0f frames/s, %.0f bytes/s, %.1f%% cpu, %zu decode errors, %zu unknown, %zu wrong size\n",
+                        (frames - reportFrames) / elapsed,
+                        (bytes - reportBytes) / elapsed,
+                        100 * (cpu - reportCpu) / elapsed,
+                        link.decodeErrorCount(),
+                        router.unknownCount(),
+                        router.sizeErrorCount());
+
+                reportStart = now;
+                reportCpu = cpu;
+                reportFrames = frames;
+                reportBytes = bytes;
+            }
+        }
+
+        double elapsed = wallSeconds() - runStart;
+
+        fprintf(stderr, "total: %llu frames in %.1f s, %.0f frames/s, %.1f%% cpu\n",
+                (unsigned long long)frames,
+                elapsed,
+                frames / elapsed,
+                100 * (cpuSeconds() - runCpu) / elapsed);
+
+        if (child > 0)
+        {
+            kill(child, SIGTERM);
+            waitpid(child, nullptr, 0);
+        }
+
+        if (options.socketPath)
+            unlink(options.socketPath);
+
+        return 0;
+    }
+
+    void usage(const char* name)
+    {
+        fprintf(stderr, "usage: %s [-e cobs|slip] [-l] [-o file] [-s socket] [-c window] [-r seconds] tty [baud]\n"
+                        "       %s -g seconds [options] [baud]\n", name, name);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    int option;
+
+    while ((option = getopt(argc, argv, "e:lo:s:c:r:g:")) != -1)
+    {
+        switch (option)
+        {
+            case 'e': options.encoding = optarg; break;
+            case 'l': options.littleEndian = true; break;
+            case 'o': options.outputPath = optarg; break;
+            case 's': options.socketPath = optarg; break;
+            case 'c': options.creditWindow = (uint16_t)atoi(optarg); break;
+            case 'r': options.reportSeconds = atof(optarg); break;
+            case 'g': options.generateSeconds = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    const char* path = nullptr;
+
+    if (options.generateSeconds <= 0)
+    {
+        if (optind >= argc)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+
+        path = argv[optind++];
+    }
+
+    if (optind < argc)
+        options.baud = strtoul(argv[optind], nullptr, 10);
+
+    if (path != nullptr && !TTYStream::supportsSpeed(options.baud))
+    {
+        fprintf(stderr, "%s: unsupported baud rate %lu\n", argv[0], options.baud);
+        return 2;
+    }
+
+    if (options.reportSeconds <= 0)
+        options.reportSeconds = 5;
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (strcmp(options.encoding, "slip") == 0)
+        return run<SLIP, SLIP::END>(path, options);
+
+    return run<COBS, 0>(path, options);
+}
@@ -0,0 +1,316 @@
+//
+// SPDX-License-Identifier: MIT
+//
+// Host-side end-to-end latency histograms for DeviceData traffic.
+//
+// Reads PacketSerial_ frames from a serial port on Linux, without the
+// TWELITE SDK:
+//
+//     g++ -std=c++11 -O2 -I../.. -o latency latency.cpp
+//     ./latency [-e cobs|slip] [-u ms|us] [-l] [-i seconds] /dev/ttyUSB0 [baud]
+//
+// Each frame is stamped by PacketSerial_ when its first byte and its marker
+// are read (see PacketSerialTimestamp). The marker time is compared with the
+// `timestamp` field of the DeviceData struct in the frame, which the sensor
+// set when it took the sample.
+//
+// The sensor clocks are not synchronised with the host, so the difference
+// holds an unknown offset per board. The smallest difference seen in each
+// interval is taken as the fixed part, and the histogram shows how much
+// later than that each sample arrived: the queueing, radio retry and UART
+// delays. The UART transfer time (marker time minus first byte time) is an
+// absolute measure and is reported alongside.
+//
+// Options:
+//
+//     -e   the link encoding, cobs (default) or slip
+//     -u   the unit of the struct timestamps, ms (default, millis()) or us
+//     -l   the structs are little-endian (the JN516x is big-endian)
+//     -i   the report interval in seconds (default 10)
+//
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+#define PACKETSERIAL_HOST
+#include "PacketSerial/PacketSerial.h"
+#include "PacketSerial/tools/TTYStream.h"
+#include "SensorPacket.h"
+
+namespace
+{
+    /// \brief The name and struct size of each DeviceID, by upper nibble.
+    struct DeviceType
+    {
+        const char* name;
+        size_t size;
+        size_t timestampOffset;
+    };
+
+    const DeviceType deviceTypes[16] = {
+        { "MainBoard", 0, 0 },
+        { "ServoController", sizeof(DeviceData::ServoData), offsetof(DeviceData::ServoData, timestamp) },
+        { "Tachometer", sizeof(DeviceData::TachometerData), offsetof(DeviceData::TachometerData, timestamp) },
+        { "Pitot", sizeof(DeviceData::PitotData), offsetof(DeviceData::PitotData, timestamp) },
+        { "IMU", sizeof(DeviceData::IMUData), offsetof(DeviceData::IMUData, timestamp) },
+        { "UltraSonic", sizeof(DeviceData::UltraSonicData), offsetof(DeviceData::UltraSonicData, timestamp) },
+        { "GPS", sizeof(DeviceData::GPSData), offsetof(DeviceData::GPSData, timestamp) },
+        { "Vane", sizeof(DeviceData::VaneData), offsetof(DeviceData::VaneData, timestamp) },
+        { nullptr, 0, 0 },
+        { "Barometer", sizeof(DeviceData::BarometerData), offsetof(DeviceData::BarometerData, timestamp) },
+        { nullptr, 0, 0 }, { nullptr, 0, 0 }, { nullptr, 0, 0 },
+        { nullptr, 0, 0 }, { nullptr, 0, 0 }, { nullptr, 0, 0 }
+    };
+
+    /// \brief The samples of one board (one full id byte) in this interval.
+    struct Board
+    {
+        std::vector<int64_t> offsets;
+        uint32_t firstOffset = 0;
+        uint64_t transferMicros = 0;
+        uint32_t maxTransferMicros = 0;
+        uint32_t sizeErrors = 0;
+    };
+
+    /// \brief Collects the samples of every board.
+    struct Latency
+    {
+        Board boards[256];
+        uint32_t unknown = 0;
+        uint32_t timestampScale = 1000;
+        bool littleEndian = false;
+    };
+
+    /// \brief The PacketSerial_ HandlerType: stores the timing of each frame.
+    struct LatencyHandler
+    {
+        Latency* latency;
+
+        void operator()(const uint8_t* buffer, size_t size, const PacketSerialTimestamp& timestamp) const
+        {
+            if (size == 0)
+                return;
+
+            const DeviceType& type = deviceTypes[buffer[0] >> 4];
+            Board& board = latency->boards[buffer[0]];
+
+            if (type.size == 0)
+            {
+                latency->unknown++;
+                return;
+            }
+
+            if (size != type.size)
+            {
+                board.sizeErrors++;
+                return;
+            }
+
+            const uint8_t* field = buffer + type.timestampOffset;
+            uint32_t sampleTime = latency->littleEndian
+                ? (uint32_t)field[0] | (uint32_t)field[1] << 8 | (uint32_t)field[2] << 16 | (uint32_t)field[3] << 24
+                : (uint32_t)field[3] | (uint32_t)field[2] << 8 | (uint32_t)field[1] << 16 | (uint32_t)field[0] << 24;
+
+            // Differences wrap with the 32-bit clocks; only their spread
+            // matters. Keep them relative to the first sample of the
+            // interval, so an offset near +-2^31 us does not sort apart
+            // from its neighbours.
+            uint32_t offset = timestamp.markerMicros - sampleTime * latency->timestampScale;
+
+            if (board.offsets.empty())
+                board.firstOffset = offset;
+
+            board.offsets.push_back((int32_t)(offset - board.firstOffset));
+
+            uint32_t transfer = timestamp.markerMicros - timestamp.firstByteMicros;
+            board.transferMicros += transfer;
+            board.maxTransferMicros = std::max(board.maxTransferMicros, transfer);
+        }
+    };
+
+    volatile sig_atomic_t stopping = 0;
+
+    void onSignal(int)
+    {
+        stopping = 1;
+    }
+
+    /// \brief Print one board's histogram and clear its samples.
+    void report(uint8_t id, Board& board)
+    {
+        if (board.offsets.empty() && board.sizeErrors == 0)
+            return;
+
+        printf("%s board %u (0x%02X): %zu samples",
+               deviceTypes[id >> 4].name, id & 0x0F, id, board.offsets.size());
+
+        if (board.sizeErrors > 0)
+            printf(", %u wrong size", board.sizeErrors);
+
+        printf("\n");
+
+        if (board.offsets.empty())
+        {
+            board = Board();
+            return;
+        }
+
+        std::vector<int64_t>& offsets = board.offsets;
+        std::sort(offsets.begin(), offsets.end());
+
+        int64_t fixed = offsets.front();
+        size_t count = offsets.size();
+
+        printf("    uart transfer: avg %.0f us, max %u us\n",
+               (double)board.transferMicros / count, board.maxTransferMicros);
+        printf("    latency over the fastest sample: p50 %lld us, p90 %lld us, p99 %lld us, max %lld us\n",
+               (long long)(offsets[count / 2] - fixed),
+               (long long)(offsets[count * 9 / 10] - fixed),
+               (long long)(offsets[count * 99 / 100] - fixed),
+               (long long)(offsets.back() - fixed));
+
+        // Power-of-two buckets from < 256 us up to >= 1 s.
+        static const int bucketCount = 14;
+        size_t buckets[bucketCount] = { 0 };
+
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t excess = (uint64_t)(offsets[i] - fixed);
+            int bucket = 0;
+
+            while (bucket < bucketCount - 1 && excess >= (256u << bucket))
+                bucket++;
+
+            buckets[bucket]++;
+        }
+
+        for (int bucket = 0; bucket < bucketCount; bucket++)
+        {
+            if (buckets[bucket] == 0)
+                continue;
+
+            int width = (int)(buckets[bucket] * 50 / count);
+
+            if (bucket < bucketCount - 1)
+                printf("    < %8u us %7zu |", 256u << bucket, buckets[bucket]);
+            else
+                printf("    >=%8u us %7zu |", 256u << (bucket - 1), buckets[bucket]);
+
+            for (int i = 0; i < width; i++)
+                putchar('#');
+
+            putchar('\n');
+        }
+
+        board = Board();
+    }
+
+    void reportAll(Latency& latency)
+    {
+        for (int id = 0; id < 256; id++)
+            report((uint8_t)id, latency.boards[id]);
+
+        if (latency.unknown > 0)
+            printf("%u frames with an unknown DeviceID\n", latency.unknown);
+
+        latency.unknown = 0;
+        printf("\n");
+        fflush(stdout);
+    }
+
+    template<typename EncoderType, uint8_t PacketMarker>
+    int run(TTYStream& stream, Latency& latency, uint32_t interval)
+    {
+        LatencyHandler handler = { &latency };
+        PacketSerial_<EncoderType, PacketMarker, 256, false, NoFrameCheck, PacketSerialOptions<LatencyHandler, TTYStream> > link(stream, handler);
+
+        pollfd fds = { stream.fd(), POLLIN, 0 };
+        uint32_t lastReport = PacketSerialMillis();
+
+        while (!stopping)
+        {
+            if (poll(&fds, 1, 100) < 0 && !stopping)
+            {
+                perror("poll");
+                return 1;
+            }
+
+            link.update();
+
+            if (PacketSerialMillis() - lastReport >= interval * 1000)
+            {
+                lastReport = PacketSerialMillis();
+                reportAll(latency);
+            }
+        }
+
+        reportAll(latency);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* encoding = "cobs";
+    uint32_t interval = 10;
+    static Latency latency;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "e:u:li:")) != -1)
+    {
+        switch (option)
+        {
+            case 'e': encoding = optarg; break;
+            case 'u': latency.timestampScale = strcmp(optarg, "us") == 0 ? 1 : 1000; break;
+            case 'l': latency.littleEndian = true; break;
+            case 'i': interval = (uint32_t)atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-e cobs|slip] [-u ms|us] [-l] [-i seconds] tty [baud]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-e cobs|slip] [-u ms|us] [-l] [-i seconds] tty [baud]\n", argv[0]);
+        return 2;
+    }
+
+    const char* path = argv[optind];
+    unsigned long baud = (optind + 1 < argc) ? strtoul(argv[optind + 1], nullptr, 10) : 115200;
+
+    if (!TTYStream::supportsSpeed(baud))
+    {
+        fprintf(stderr, "%s: unsupported baud rate %lu\n", argv[0], baud);
+        return 2;
+    }
+
+    TTYStream stream;
+
+    if (!stream.open(path, baud))
+    {
+        perror(path);
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    if (interval == 0)
+        interval = 1;
+
+    if (strcmp(encoding, "slip") == 0)
+        return run<SLIP, SLIP::END>(stream, latency, interval);
+
+    return run<COBS, 0>(stream, latency, interval);
+}
@@ -0,0 +1,390 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// \brief The ways a CRC can be computed, from smallest to fastest.
+///
+/// | Engine      | Table size         | Work per byte           |
+/// |-------------|--------------------|-------------------------|
+/// | CRC_BITWISE | none               | 8 shifts                |
+/// | CRC_NIBBLE  | 16 entries         | 2 lookups               |
+/// | CRC_TABLE   | 256 entries        | 1 lookup                |
+/// | CRC_SLICE8  | 8 x 256 entries    | 1 lookup, 8 bytes a time|
+///
+/// All tables are computed at compile time and live in flash. CRC_SLICE8
+/// only applies to reflected 32-bit CRCs such as CRC-32; other models fall
+/// back to CRC_TABLE.
+enum CRCEngine
+{
+    CRC_BITWISE,
+    CRC_NIBBLE,
+    CRC_TABLE,
+    CRC_SLICE8
+};
+
+/// \brief The engine used when none is given.
+///
+/// Define CRC_DEFAULT_ENGINE before including this file to override it. The
+/// JN516x gets the nibble tables, which cost 16 entries of flash per model.
+#ifndef CRC_DEFAULT_ENGINE
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define CRC_DEFAULT_ENGINE CRC_SLICE8
+#else
+#define CRC_DEFAULT_ENGINE CRC_NIBBLE
+#endif
+#endif
+
+/// \brief A CRC model in the usual catalogue form.
+///
+/// Reflected models take the reversed polynomial and shift right.
+///
+/// \tparam ValueType uint8_t, uint16_t or uint32_t.
+/// \tparam Poly The generator polynomial.
+/// \tparam Init The initial register value.
+/// \tparam Reflected true if the bytes are processed least significant bit
+///         first.
+/// \tparam XorOut The value XORed into the register to give the CRC.
+/// \tparam Residue The register value after running over data followed by
+///         its own CRC.
+template<typename ValueType, uint32_t Poly, uint32_t Init, bool Reflected, uint32_t XorOut, uint32_t Residue>
+struct CRCModel
+{
+    typedef ValueType Value;
+
+    enum
+    {
+        Width = 8 * sizeof(ValueType)
+    };
+
+    static constexpr Value poly = (Value)Poly;
+    static constexpr Value init = (Value)Init;
+    static constexpr bool reflected = Reflected;
+    static constexpr Value xorOut = (Value)XorOut;
+    static constexpr Value residue = (Value)Residue;
+};
+
+/// \brief CRC-8/NRSC-5 as used by Sensirion sensors (poly 0x31, init 0xFF).
+typedef CRCModel<uint8_t, 0x31, 0xFF, false, 0x00, 0x00> CRC8Sensirion;
+
+/// \brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF).
+typedef CRCModel<uint16_t, 0x1021, 0xFFFF, false, 0x0000, 0x0000> CRC16CCITT;
+
+/// \brief CRC-32 as used by Ethernet and zlib (reflected poly 0xEDB88320).
+typedef CRCModel<uint32_t, 0xEDB88320, 0xFFFFFFFF, true, 0xFFFFFFFF, 0xDEBB20E3> CRC32IEEE;
+
+
+/// \brief Compile-time CRC tables for a model.
+template<typename Model>
+class CRCTables
+{
+public:
+    typedef typename Model::Value Value;
+
+    /// \brief Run \p bits zero bits through a register value.
+    static constexpr Value step(Value crc, int bits)
+    {
+        return bits == 0 ? crc
+             : Model::reflected ? step((Value)((crc & 1) ? (crc >> 1) ^ Model::poly : (crc >> 1)), bits - 1)
+             : step((Value)((crc >> (Model::Width - 1)) ? (crc << 1) ^ Model::poly : (crc << 1)), bits - 1);
+    }
+
+    /// \brief The register change for one nibble.
+    static constexpr Value nibbleEntry(uint32_t index)
+    {
+        return Model::reflected ? step((Value)index, 4)
+                                : step((Value)((Value)index << (Model::Width - 4)), 4);
+    }
+
+    /// \brief The register change for one byte.
+    static constexpr Value byteEntry(uint32_t index)
+    {
+        return Model::reflected ? step((Value)index, 8)
+                                : step((Value)((Value)index << (Model::Width - 8)), 8);
+    }
+
+    /// \brief Advance a byte table entry past one more zero byte.
+    static constexpr Value sliceStep(Value crc)
+    {
+        return (Value)((crc >> 8) ^ byteEntry(crc & 0xFF));
+    }
+
+    /// \brief Entry \p index of slice table \p index / 256.
+    static constexpr Value sliceEntry(uint32_t index)
+    {
+        return index < 256 ? byteEntry(index) : sliceStep(sliceEntry(index - 256));
+    }
+
+    static const Value nibble[16];
+    static const Value byte[256];
+    static const Value slice[8 * 256];
+};
+
+#define CRC_TABLE_4(f, n)    f(n), f(n + 1), f(n + 2), f(n + 3)
+#define CRC_TABLE_16(f, n)   CRC_TABLE_4(f, n), CRC_TABLE_4(f, n + 4), CRC_TABLE_4(f, n + 8), CRC_TABLE_4(f, n + 12)
+#define CRC_TABLE_64(f, n)   CRC_TABLE_16(f, n), CRC_TABLE_16(f, n + 16), CRC_TABLE_16(f, n + 32), CRC_TABLE_16(f, n + 48)
+#define CRC_TABLE_256(f, n)  CRC_TABLE_64(f, n), CRC_TABLE_64(f, n + 64), CRC_TABLE_64(f, n + 128), CRC_TABLE_64(f, n + 192)
+#define CRC_TABLE_1024(f, n) CRC_TABLE_256(f, n), CRC_TABLE_256(f, n + 256), CRC_TABLE_256(f, n + 512), CRC_TABLE_256(f, n + 768)
+
+template<typename Model>
+const typename Model::Value CRCTables<Model>::nibble[16] = {
+    CRC_TABLE_16(CRCTables<Model>::nibbleEntry, 0)
+};
+
+template<typename Model>
+const typename Model::Value CRCTables<Model>::byte[256] = {
+    CRC_TABLE_256(CRCTables<Model>::byteEntry, 0)
+};
+
+template<typename Model>
+const typename Model::Value CRCTables<Model>::slice[8 * 256] = {
+    CRC_TABLE_1024(CRCTables<Model>::sliceEntry, 0),
+    CRC_TABLE_1024(CRCTables<Model>::sliceEntry, 1024)
+};
+
+#undef CRC_TABLE_4
+#undef CRC_TABLE_16
+#undef CRC_TABLE_64
+#undef CRC_TABLE_256
+#undef CRC_TABLE_1024
+
+
+/// \brief The register update loop for each engine.
+template<typename Model, int Engine, bool Reflected = Model::reflected>
+struct CRCUpdate;
+
+template<typename Model, bool Reflected>
+struct CRCUpdate<Model, CRC_BITWISE, Reflected>
+{
+    typedef typename Model::Value Value;
+
+    static Value update(Value crc, const uint8_t* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (Model::reflected)
+                crc ^= data[i];
+            else
+                crc ^= (Value)((Value)data[i] << (Model::Width - 8));
+
+            crc = CRCTables<Model>::step(crc, 8);
+        }
+
+        return crc;
+    }
+};
+
+template<typename Model>
+struct CRCUpdate<Model, CRC_NIBBLE, false>
+{
+    typedef typename Model::Value Value;
+
+    static Value update(Value crc, const uint8_t* data, size_t size)
+    {
+        const Value* table = CRCTables<Model>::nibble;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = (Value)((crc << 4) ^ table[((crc >> (Model::Width - 4)) ^ (data[i] >> 4)) & 0x0F]);
+            crc = (Value)((crc << 4) ^ table[((crc >> (Model::Width - 4)) ^ data[i]) & 0x0F]);
+        }
+
+        return crc;
+    }
+};
+
+template<typename Model>
+struct CRCUpdate<Model, CRC_NIBBLE, true>
+{
+    typedef typename Model::Value Value;
+
+    static Value update(Value crc, const uint8_t* data, size_t size)
+    {
+        const Value* table = CRCTables<Model>::nibble;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = (Value)((crc >> 4) ^ table[(crc ^ data[i]) & 0x0F]);
+            crc = (Value)((crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 0x0F]);
+        }
+
+        return crc;
+    }
+};
+
+template<typename Model>
+struct CRCUpdate<Model, CRC_TABLE, false>
+{
+    typedef typename Model::Value Value;
+
+    static Value update(Value crc, const uint8_t* data, size_t size)
+    {
+        const Value* table = CRCTables<Model>::byte;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = (Value)(((uint32_t)crc << 8) ^ table[((crc >> (Model::Width - 8)) ^ data[i]) & 0xFF]);
+        }
+
+        return crc;
+    }
+};
+
+template<typename Model>
+struct CRCUpdate<Model, CRC_TABLE, true>
+{
+    typedef typename Model::Value Value;
+
+    static Value update(Value crc, const uint8_t* data, size_t size)
+    {
+        const Value* table = CRCTables<Model>::byte;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = (Value)(((uint32_t)crc >> 8) ^ table[(crc ^ data[i]) & 0xFF]);
+        }
+
+        return crc;
+    }
+};
+
+/// \brief Slicing-by-8 only pays off for reflected 32-bit CRCs.
+template<typename Model>
+struct CRCUpdate<Model, CRC_SLICE8, false> : CRCUpdate<Model, CRC_TABLE, false>
+{
+};
+
+template<typename Model>
+struct CRCUpdate<Model, CRC_SLICE8, true>
+{
+    typedef typename Model::Value Value;
+
+    static Value update(Value crc, const uint8_t* data, size_t size)
+    {
+        if (Model::Width != 32)
+            return CRCUpdate<Model, CRC_TABLE, true>::update(crc, data, size);
+
+        const Value* table = CRCTables<Model>::slice;
+
+        while (size >= 8)
+        {
+            uint32_t one = (uint32_t)crc ^ ((uint32_t)data[0]
+                                          | (uint32_t)data[1] << 8
+                                          | (uint32_t)data[2] << 16
+                                          | (uint32_t)data[3] << 24);
+
+            crc = (Value)(table[7 * 256 + (one & 0xFF)]
+                        ^ table[6 * 256 + ((one >> 8) & 0xFF)]
+                        ^ table[5 * 256 + ((one >> 16) & 0xFF)]
+                        ^ table[4 * 256 + (one >> 24)]
+                        ^ table[3 * 256 + data[4]]
+                        ^ table[2 * 256 + data[5]]
+                        ^ table[1 * 256 + data[6]]
+                        ^ table[data[7]]);
+
+            data += 8;
+            size -= 8;
+        }
+
+        return CRCUpdate<Model, CRC_TABLE, true>::update(crc, data, size);
+    }
+};
+
+
+/// \brief A running CRC.
+///
+///     // One-shot, e.g. a Sensirion word:
+///     uint8_t crc = CRC<CRC8Sensirion>::compute(data, 2);
+///
+///     // Incremental:
+///     CRC<CRC32IEEE> crc;
+///     crc.update(header, sizeof(header));
+///     crc.update(payload, size);
+///     uint32_t value = crc.value();
+///
+/// A CRC is also a PacketSerial_ frame check (see FrameCheck.h): get() writes
+/// the CRC in wire order, and valid() tells whether the data ended with its
+/// own CRC.
+///
+/// \tparam Model The CRC parameters, e.g. CRC16CCITT.
+/// \tparam Engine The CRCEngine to compute it with.
+template<typename Model, int Engine = CRC_DEFAULT_ENGINE>
+class CRC
+{
+public:
+    typedef typename Model::Value Value;
+
+    enum
+    {
+        /// \brief The number of bytes in the CRC.
+        Size = sizeof(Value)
+    };
+
+    CRC():
+        _crc(Model::init)
+    {
+    }
+
+    /// \brief Start over.
+    void reset()
+    {
+        _crc = Model::init;
+    }
+
+    /// \brief Add one byte.
+    void update(uint8_t data)
+    {
+        _crc = CRCUpdate<Model, Engine>::update(_crc, &data, 1);
+    }
+
+    /// \brief Add several bytes.
+    void update(const uint8_t* data, size_t size)
+    {
+        _crc = CRCUpdate<Model, Engine>::update(_crc, data, size);
+    }
+
+    /// \returns the CRC of the bytes added so far.
+    Value value() const
+    {
+        return (Value)(_crc ^ Model::xorOut);
+    }
+
+    /// \brief Write the CRC in wire order.
+    ///
+    /// Most significant byte first for normal models, least significant
+    /// byte first for reflected ones, so that valid() holds after the CRC
+    /// is run over its own value.
+    ///
+    /// \param value A buffer of at least Size bytes.
+    void get(uint8_t* value) const
+    {
+        Value crc = this->value();
+
+        for (size_t i = 0; i < (size_t)Size; i++)
+        {
+            size_t shift = Model::reflected ? 8 * i : 8 * (Size - 1 - i);
+            value[i] = (uint8_t)(crc >> shift);
+        }
+    }
+
+    /// \returns true if the bytes added so far end with their own CRC, as
+    ///          written by get().
+    bool valid() const
+    {
+        return _crc == Model::residue;
+    }
+
+    /// \brief Compute the CRC of a buffer.
+    static Value compute(const uint8_t* data, size_t size)
+    {
+        return (Value)(CRCUpdate<Model, Engine>::update(Model::init, data, size) ^ Model::xorOut);
+    }
+
+private:
+    Value _crc;
+};
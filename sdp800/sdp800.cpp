@@ -1,5 +1,6 @@
 #include"sdp800.h"
 #include <TWELITE>
+#include "../crc/crc.h"
 
 namespace
 {
@@ -39,7 +40,14 @@ int SDP800::readSample()
         return ret;
     }
 
-    // TODO: check CRC
+    // Each 16-bit word is followed by its CRC.
+    for (uint8_t i = 0; i < DATA_LEN; i += 3)
+    {
+        if (crc8(data + i, 2) != data[i + 2])
+        {
+            return 2;
+        }
+    }
 
     int16_t dp_raw = (int16_t)data[0] << 8 | data[1];
     int16_t temp_raw = (int16_t)data[3] << 8 | data[4];
@@ -100,23 +108,6 @@ int8_t SDP800::i2c_read(uint8_t addr, uint8_t *data, uint16_t count)
 uint8_t SDP800::crc8(const uint8_t *data, uint8_t len)
 {
     // adapted from SHT21 sample code from http://www.sensirion.com/en/products/humidity-temperature/download-center/
-
-    uint8_t crc = 0xff;
-    uint8_t byteCtr;
-    for (byteCtr = 0; byteCtr < len; ++byteCtr)
-    {
-        crc ^= (data[byteCtr]);
-        for (uint8_t bit = 8; bit > 0; --bit)
-        {
-            if (crc & 0x80)
-            {
-                crc = (crc << 1) ^ 0x31;
-            }
-            else
-            {
-                crc = (crc << 1);
-            }
-        }
-    }
-    return crc;
+    // Sensirion CRC-8: polynomial 0x31, initial value 0xFF.
+    return CRC<CRC8Sensirion>::compute(data, len);
 }